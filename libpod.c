@@ -0,0 +1,3349 @@
+//
+//  libpod.c
+//  pod
+//
+//
+// Copyright (C) 2012 Scott McCoid, Gregoire Tronel, Jay Clark
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy of this software
+// and associated documentation files (the "Software"), to deal in the Software without restriction,
+// including without limitation the rights to use, copy, modify, merge, publish, distribute, sublicense,
+// and/or sell copies of the Software, and to permit persons to whom the Software is furnished to do so,
+// subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in all copies or substantial
+// portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR IMPLIED, INCLUDING BUT NOT
+// LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.
+// IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY,
+// WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE
+// SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+
+
+#include "libpod.h"
+#include "pod_sos.h"
+#include "pod_fft.h"
+#include "pod_sdft.h"
+#include "pod_bank.h"
+#include "pod_stats.h"
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <pthread.h>
+#include <unistd.h>
+
+#if defined(POD_CPU_X86)
+#include <immintrin.h>
+#endif
+#if defined(POD_CPU_NEON)
+#include <arm_neon.h>
+#endif
+
+#ifdef __APPLE__
+#include <dispatch/dispatch.h>
+#else
+#include <semaphore.h>
+#endif
+
+#ifdef POD_PROFILE
+#ifdef __APPLE__
+#include <mach/mach_time.h>
+#else
+#include <time.h>
+#endif
+#endif
+
+#pragma mark - Definitions -
+
+#define FS 44100.0                              // when the host does not say
+#define PI 3.14159265359
+#define TWO_PI (2 * PI)
+#define NUM_BARKS POD_NUM_BARKS
+#define SLICE_SIZE 1024                         // samples or bins handled by one slice of a spread frame
+#define CACHE_LINE POD_FFT_ALIGNMENT
+#define ARENA_LINE (CACHE_LINE / (int) sizeof(float))
+#define CACHE_ALIGNED __attribute__((aligned(CACHE_LINE)))
+#define CHECK_CHANNELS 15                       // one group of eight lanes, one of four, a pair and one left over
+#define MIN_BAND_BINS 4                         // bins a window needs under a Bark band to supply it
+#define MIN_RESOLUTION 64                       // shortest extra window
+#define POD_MAX_WORKERS 4                       // threads the detectors with a latency share, one less than the cores
+
+// Where a spread frame picks up on the next block
+enum { SLICE_IDLE, SLICE_WINDOW, SLICE_FFT, SLICE_MAGNITUDE, SLICE_BANDS };
+
+// define bark limits and centers
+int bark_lim[25] =  { 20, 100, 200, 300, 400, 510, 630, 770, 920, 1080, 1270, 1480, 1720, 2000, 2320, 2700, 3150, 3700, 4400, 5300, 6400, 7700, 9500, 12000, 15500 };
+int bark_ctr[26] = {0, 50, 150, 250, 350, 450, 570, 700, 840, 1000, 1170, 1370, 1600, 1850, 2150, 2500, 2900, 3400, 4000, 4800, 5800, 7000, 8500, 10500, 13500, 15500};
+float band_weightings[24] = { 0.7762, 0.6854, 0.6647, 0.6373, 0.6255, 0.6170, 0.6139, 0.6107, 0.6127, 0.6329, 0.6380, 0.6430, 0.6151, 0.6033, 0.5914, 0.5843, 0.5895, 0.5947, 0.6237, 0.6703, 0.6920, 0.7137, 0.7217, 0.7217 };
+
+#ifdef POD_PROFILE
+#define PROFILE_START() double profile_mark = profile_now()
+#define PROFILE_RESTART() profile_mark = profile_now()
+#define PROFILE_STAGE(profile, stage) do { double now = profile_now(); (profile)->ns[stage] += now - profile_mark; profile_mark = now; } while (0)
+#define PROFILE_OF(owner) (&(owner)->profile)
+#else
+#define PROFILE_START()
+#define PROFILE_RESTART()
+#define PROFILE_STAGE(profile, stage)
+#define PROFILE_OF(owner) NULL
+#endif
+
+// Counting semaphores are the one primitive that lets the audio thread hand work over without taking a lock
+#ifdef __APPLE__
+typedef dispatch_semaphore_t t_pod_sem;
+#define POD_SEM_INIT(s) ((*(s) = dispatch_semaphore_create(0)) != NULL ? 0 : -1)
+#define POD_SEM_POST(s) dispatch_semaphore_signal(*(s))
+#define POD_SEM_WAIT(s) dispatch_semaphore_wait(*(s), DISPATCH_TIME_FOREVER)
+#define POD_SEM_DESTROY(s) dispatch_release(*(s))
+#else
+typedef sem_t t_pod_sem;
+#define POD_SEM_INIT(s) sem_init(s, 0, 0)
+#define POD_SEM_POST(s) sem_post(s)
+#define POD_SEM_WAIT(s) while (sem_wait(s) != 0)
+#define POD_SEM_DESTROY(s) sem_destroy(s)
+#endif
+
+static t_pod* detectors = NULL;                 // every live detector, newest first
+static t_pod_isa kernel_isa = POD_ISA_SCALAR;   // the instruction set every detector's kernels use
+static int isa_chosen = 0;                      // pod_init or pod_set_isa has run
+
+static const char* stage_names[POD_NUM_STAGES] = { "ear_filter", "window", "fft", "magnitude", "bark", "loudness", "flux", "peak_picking" };
+
+typedef struct _bark_band
+{
+    int         start;                          // first fft bin the band covers
+    int         length;                         // number of bins the band covers
+    float*      weights;                        // triangular weights, one per covered bin
+    
+} t_bark_band;
+
+// The read-only tables for one window type, window size and sample rate: the analysis window and the
+// triangular Bark filters. Made once, aligned, and shared by every detector that needs the same three.
+typedef struct _pod_tables
+{
+    int         window_type;
+    int         window_size;
+    float       sample_rate;
+    int         refcount;
+    float*      window;                         // window_size, with the fft's 1 / window_size folded in
+    t_bark_band bands[NUM_BARKS];
+    int         bins;                           // every band reads from bins below this, about 15.5 kHz
+    float*      weights;                        // backing store for every band's weights
+    struct _pod_tables* next;
+    
+} t_pod_tables;
+
+static t_pod_tables* shared_tables = NULL;      // every set of tables in use
+
+typedef struct _pod_channel
+{
+    //peak picking
+    float       bark_bins[NUM_BARKS];
+    float       prev_bark_bins[NUM_BARKS];
+    float       u_threshold, l_threshold;
+    float       bark_difference;
+    float       peak_value;
+    long long   peak_sample;                    // sample_count of the frame peak_value came from
+    int         flag;
+    int         debounce_iterator;
+    t_pod_stats* average;                       // recent flux, for automatic thresholds
+    int         consecutive_onset_filtering_iterator;
+    int         consecutive_onset_flag;
+    int         maskFlag;
+    int         maskIterator;
+    
+} t_pod_channel;
+
+// One hop's worth of work for the worker: a copy of the signal history, oldest sample first, and the
+// Bark bands it turns into
+typedef struct _pod_frame
+{
+    float*      signal;                         // window_size frames, channels interleaved
+    float*      bark_bins;                      // NUM_BARKS per channel
+    long long   sample;                         // sample_count when the frame was taken
+    long long   done;                           // k + 1 once the worker has put frame k's bands in bark_bins
+#ifdef POD_PROFILE
+    t_pod_profile profile;                      // the worker's stage timings for it, added in when it comes back
+#endif
+    
+} t_pod_frame;
+
+// One thread of the pool every detector with a latency shares. Each detector is served by one of them, so
+// its frames are analysed in order and never two at once; the detectors it serves take turns a frame each.
+typedef struct _pod_worker
+{
+    pthread_t   thread;
+    t_pod_sem   work_ready;                     // one post per frame sent to any of its detectors
+    pthread_mutex_t lock;                       // held while it analyses a frame, and to change its detectors
+    t_pod*      detectors;                      // linked by worker_next, served from the front
+    int         count;
+    int         stop;
+    
+} t_pod_worker;
+
+// The per-frame kernels for one instruction set and channel count. A set is picked whenever the channel count
+// or the instruction set changes, never per frame.
+typedef struct _pod_kernels
+{
+    void        (*window)(float* out, const float* frame, const float* window, int stride, int size);
+    void        (*bands)(const t_bark_band* bands, const float* magnitudes, int channels, float* sums, float* bark_bins);
+    float       (*flux)(const float* bark_bins, const float* prev_bark_bins);
+    
+} t_pod_kernels;
+
+// What one frame's analysis writes on its way to the Bark bands, sized for the main window. The shorter
+// windows are analysed after it and reuse the same buffers. The detector has one set for the calling thread
+// and, with a worker, another for the worker, so both can analyse frames at once.
+typedef struct _pod_scratch
+{
+    float*      analysis;                       // this holds analysis values
+    float*      spectrum;                       // fft output, window_size / 2 + 1 complex bins
+    float*      fft_work;
+    float*      magnitudes;                     // half_window_size bins, channels interleaved
+    float*      band_sums;                      // one per channel
+    float*      bark_bins;                      // every band of a shorter window, of which its own are kept
+    
+} t_pod_scratch;
+
+// One of the shorter windows analysed alongside the main one, over the newest samples of the same frame. It
+// supplies Bark bands first_band .. last_band - 1, so it only needs the magnitudes of the bins under them.
+typedef struct _pod_resolution
+{
+    int         window_size;
+    int         first_band;
+    int         last_band;
+    int         from_bin;                       // magnitudes from_bin .. bins - 1 are found
+    int         bins;
+    const t_pod_kernels* kernels;
+    t_pod_fft_plan* fft_plan;
+    t_pod_tables* tables;                       // same window type and sample rate as the main window's
+    
+} t_pod_resolution;
+
+// Where each per-instance buffer starts in the arena, in floats. Every buffer starts on a cache line of its own,
+// in the order a block and then a frame touch them.
+typedef struct _pod_layout
+{
+    int         filter_state;
+    int         signal;
+    int         analysis;
+    int         spectrum;
+    int         fft_work;
+    int         magnitudes;
+    int         band_sums;
+    int         bark_bins;
+    int         bark_frame;
+    int         size;
+    
+} t_pod_layout;
+
+// Laid out by how often each part is touched: first what every block reads, then what every frame reads,
+// then, from a fresh cache line, what only changes with a parameter
+struct _pod
+{
+    // every block
+    float*      signal;                         // circular buffer of filtered samples, channels interleaved, see mirror_history
+    float*      filter_state;                   // ear filter state per channel when there is more than one
+    int         channels;
+    int         history_size;                   // frames in signal: a power of two holding a window and a hop
+    int         write_index;                    // next write frame in signal, also the oldest frame
+    int         window_size;
+    int         hop_size;
+    int         dsp_tick;
+    long long   sample_count;                   // samples processed since creation
+    int         engine;                         // how the spectrum is found, see t_pod_engine
+    int         latency;                        // worker thread, only when > 0
+    int         spread;                         // spreading a frame over the next hop's blocks, only when latency is 0
+    int         slice_stage;                    // what the pending frame needs next, SLICE_IDLE if nothing is pending
+    t_pod_sdft* sdft;                           // the bins the filterbank reads, slid along every sample
+    int         sdft_count;                     // samples since the sliding bins were reloaded from an fft
+    t_pod_bank* bank;                           // the Bark bands as filters, run every sample; only for that engine
+    t_pod_sos   ear_filter;                     // outer and middle ear as one cascade, with its state
+    
+    // every frame
+    t_pod_scratch scratch;                      // the calling thread's
+    float*      bark_frame;                     // NUM_BARKS per channel, the frame being picked when the worker has not got it
+    int         half_window_size;
+    int         power;                          // bands sum power rather than magnitudes
+    const t_pod_kernels* kernels;
+    t_pod_fft_plan* fft_plan;                   // shared by every instance with the same window size
+    t_pod_tables* tables;                       // window and filterbank, shared and never written after they are made
+    long long   frame_sample;                   // sample_count of the frame being picked
+    int         low_bands;                      // Bark bands the main window supplies, the rest come from resolutions
+    int         low_bins;                       // magnitudes those bands read
+    int         num_resolutions;
+    t_pod_resolution resolutions[POD_MAX_RESOLUTIONS - 1];  // longest first, see pod_set_resolutions
+    
+    //peak picking, shared by every channel
+    t_pod_channel* channel;
+    int         debounce_threshold;
+    int         consecutive_onset_filtering_threshold;
+    float       lower_threshold_scale;
+    float       upper_threshold_scale;
+    int         maskingThreshold;
+    float       maskingDecay;
+    int         automaticThresholding;
+    
+    // the rest of a spread frame
+    int         slice_channel;
+    int         slice_position;                 // first sample or bin of the next slice
+    int         slice_oldest;                   // where in signal the pending frame starts
+    long long   slice_sample;                   // sample_count when the pending frame fell due
+    
+    // worker thread
+    t_pod_frame frames[POD_MAX_LATENCY + 1];    // latency + 1 slots: the frames out and one the worker may still read
+    int         slot_of[POD_MAX_LATENCY];       // frame k is in frames[slot_of[k % latency]], see send_frame
+    long long   frames_sent;                    // only moved by the caller
+    long long   frames_received;                // only moved by the caller
+    long long   frames_claimed;                 // frames before this one are taken, by the worker or the caller
+    int         worker_slot;                    // the slot the worker is reading, -1 if none
+    int         worker_behind;                  // the last frame received was not ready
+    t_pod_scratch worker_scratch;               // the worker's own buffers, so the caller can analyse alongside it
+    float*      worker_arena;                   // holds them
+    t_pod_worker* worker;                       // the pool thread serving this detector
+    t_pod*      worker_next;                    // the next detector it serves
+    
+    // settings and bookkeeping
+    t_pod_config config CACHE_ALIGNED;
+    float*      arena;                          // every buffer above, in one allocation, see t_pod_layout
+    float       o_a1, o_a2, o_b0, o_b1, o_b2;
+    float       m_a1, m_a2, m_b0, m_b1, m_b2;
+    float       sample_rate;
+    float       consecutive_ms;                 // what the consecutive threshold was asked for
+    float       average_ms;                     // automatic thresholds follow the flux of the last average_ms, or of the whole session when 0
+    float       percentile;                     // of that flux, or -1 to follow its mean
+    int         phase;                          // frames run when sample_count + phase is a multiple of hop_size
+    int         phase_automatic;                // picked by the scheduler, and picked again when the hop changes
+    t_pod*      next;                           // every live detector, for the phase scheduler
+    
+#ifdef POD_PROFILE
+    t_pod_profile profile;
+#endif
+};
+
+//Initialization
+static t_pod_tables* tables_acquire(int window_type, int window_size, float sample_rate);
+static void tables_release(t_pod_tables* tables);
+static void create_window(t_pod_tables* tables);
+static void create_filterbank(t_pod_tables* tables);
+static void use_tables(t_pod* x, t_pod_tables* tables, t_pod_sdft* sdft);
+static t_pod_sdft* create_sdft(t_pod* x, const t_pod_tables* tables);
+static int resize_analysis(t_pod* x, int window_size, int hop_size);
+static void arena_layout(t_pod_layout* layout, const t_pod* x, int window_size, int history_size);
+static int arena_carve(int* offset, int count);
+static void use_arena(t_pod* x, float* arena, const t_pod_layout* layout);
+static int make_resolution(t_pod* x, t_pod_resolution* r, int window_size);
+static void free_resolution(t_pod_resolution* r);
+static void assign_bands(t_pod* x);
+static void refresh_resolutions(t_pod* x);
+static int consecutive_frames(t_pod* x, float ms);
+
+//Perform
+static void mirror_history(t_pod* x, int from, int to);
+static void analyze_frame(t_pod* x, const t_pod_scratch* scratch, const float* frame, float* bark_bins,
+                          t_pod_profile* profile);
+static void analyze_resolution(t_pod* x, t_pod_resolution* r, const t_pod_scratch* scratch, const float* frame,
+                               float* bark_bins, t_pod_profile* profile);
+static void window_channel(t_pod* x, const float* frame, int channel, int from, int to);
+static void magnitude_channel(t_pod* x, const t_pod_scratch* scratch, int channel, int from, int to);
+static void detect_onsets(t_pod* x, const float* bark_bins, long long sample);
+static void run_slice(t_pod* x);
+static void finish_frame(t_pod* x);
+static void sdft_frame(t_pod* x, float* bark_bins);
+static void load_sdft(t_pod* x);
+static void run_bank(t_pod* x, int start, int n);
+static void bank_frame(t_pod* x, float* bark_bins);
+static t_pod_bank* create_bank(t_pod* x, float sample_rate);
+static void raised_cosine(int window_type, float* a0, float* a1);
+static void pick_peaks(t_pod* x, t_pod_channel* c, int channel);
+static void report_onset(t_pod* x, t_pod_channel* c, int channel);
+
+//Ear Filters
+static void create_ear_filter(t_pod* x);
+static void condense_analysis(t_pod* x, const t_pod_scratch* scratch, float* bark_bins);
+static void multiply_loudness(float* bark_bins);
+
+//Kernels
+static const t_pod_kernels* select_kernels(t_pod_isa isa, int channels);
+
+//Worker
+static void start_worker(t_pod* x, int latency);
+static void stop_worker(t_pod* x);
+static void drain_worker(t_pod* x);
+static void* worker_main(void* arg);
+static int work_frame(t_pod* x);
+static int start_pool(void);
+static void stop_pool(void);
+static float* make_scratch(t_pod_scratch* scratch, int window_size, int channels);
+static void send_frame(t_pod* x, int oldest, long long sample);
+static int free_slot(const t_pod* x);
+static int receive_frame(t_pod* x);
+
+//Peak Picking Helper Functions
+static float accumulate_bin_differences(t_pod* x, t_pod_channel* c, int channel);
+static void iterate_bark_bins(t_pod_channel* c);
+static void reset_channel(t_pod* x, t_pod_channel* c);
+
+//Scheduling
+static float frame_cost(const t_pod* x);
+static int schedule_classes(const t_pod* x);
+static float* schedule_loads(const t_pod* skip, int* blocks);
+static int schedule_phase(t_pod* x);
+
+//Utilities
+static int isPowerOfTwo(unsigned int x);
+static float halfwave_rectify(float value);
+static int average_frames(t_pod* x, float ms);
+static void pod_log(t_pod* x, const char* message);
+#ifdef POD_PROFILE
+static double profile_now(void);
+#endif
+
+#pragma mark - Initialization -
+
+void pod_config_init(t_pod_config* config)
+{
+    memset(config, 0, sizeof(t_pod_config));
+    config->window_size = 1024;
+    config->hop_size = 256;
+    config->channels = 1;
+    config->phase = -1;
+    config->percentile = -1.0;
+}
+
+void pod_init(void)
+{
+    if (! isa_chosen)
+        pod_set_isa(pod_cpu_best());
+}
+
+t_pod_isa pod_get_isa(void)
+{
+    return kernel_isa;
+}
+
+int pod_set_isa(t_pod_isa isa)
+{
+    if (! pod_cpu_supports(isa))
+        return -1;
+        
+    // Workers call the kernels through the same pointers, so every frame in progress is finished and every
+    // worker left idle before any of them change
+    for (t_pod* x = detectors; x != NULL; x = x->next)
+    {
+        finish_frame(x);
+        drain_worker(x);
+    }
+    
+    kernel_isa = isa;
+    isa_chosen = 1;
+    pod_sos_use(isa);
+    pod_fft_use(isa);
+    pod_bank_use(isa);
+    
+    for (t_pod* x = detectors; x != NULL; x = x->next)
+    {
+        x->kernels = select_kernels(isa, x->channels);
+        for (int i = 0; i < x->num_resolutions; i++)
+            x->resolutions[i].kernels = select_kernels(isa, x->channels);
+    }
+    
+    return 0;
+}
+
+t_pod* pod_create(const t_pod_config* config)
+{
+    void* memory = NULL;
+    t_pod_layout layout;
+    
+    pod_init();
+    
+    // aligned, so the hot fields share as few cache lines as they can
+    if (posix_memalign(&memory, CACHE_LINE, sizeof(t_pod)) != 0)
+        return NULL;
+        
+    t_pod* x = (t_pod *)memory;
+    memset(x, 0, sizeof(t_pod));
+    
+    x->config = *config;
+    
+    // Initialize filter coeffs
+    // Outer
+    x->o_a1 = 0.0;
+    x->o_a2 = 0.0;
+    x->o_b0 = 0.0;
+    x->o_b1 = 0.7221;
+    x->o_b2 = -0.6918;
+    
+    // Middle
+    x->m_a1 = 1.6456;
+    x->m_a2 = 0.6791;
+    x->m_b0 = 0.8383;
+    x->m_b1 = 0.0;
+    x->m_b2 = -0.8383;
+    
+    create_ear_filter(x);
+    
+    // Window Size
+    if (! isPowerOfTwo(config->window_size)){
+        pod_log(x, "Window size must be a power of two. Applying default window.");
+        x->window_size = 1024;
+    }
+    else x->window_size = config->window_size;
+    
+    x->half_window_size = x->window_size / 2;
+    x->sample_rate = config->sample_rate > 0.0 ? config->sample_rate : FS;
+    x->channels = config->channels > 0 ? config->channels : 1;
+    
+    if (! isPowerOfTwo(config->hop_size)){
+        pod_log(x, "Hop size must be a power of two. Applying default hop size.");
+        x->hop_size = 256;
+    }
+    else x->hop_size = config->hop_size; // This is in samples
+    
+    // A frame has to stay in the history for the hop it may take to analyse when spread
+    x->history_size = x->window_size;
+    while (x->history_size < x->window_size + x->hop_size)
+        x->history_size *= 2;
+    
+    // one aligned and zeroed arena for every buffer
+    arena_layout(&layout, x, x->window_size, x->history_size);
+    x->arena = pod_fft_alloc(layout.size);
+    if (x->arena != NULL)
+        use_arena(x, x->arena, &layout);
+    x->channel = (t_pod_channel *)calloc(x->channels, sizeof(t_pod_channel));
+    x->fft_plan = pod_fft_plan_acquire(x->window_size);
+    
+    // window (default hanning) and sparse filter-bank associated with window size and sample rate; the
+    // sliding dft is only made by pod_set_engine
+    x->tables = tables_acquire(0, x->window_size, x->sample_rate);
+    if (x->tables != NULL)
+        assign_bands(x);
+    x->kernels = select_kernels(kernel_isa, x->channels);
+    
+    x->dsp_tick = 0;
+    x->write_index = 0;
+    x->sample_count = 0;
+    x->slice_stage = SLICE_IDLE;
+    
+    //Peak picking.
+    
+    x->debounce_threshold=5;
+    x->upper_threshold_scale = 10.0;
+    x->lower_threshold_scale = 1.0;
+    x->consecutive_ms = 30;
+    x->consecutive_onset_filtering_threshold = consecutive_frames(x, x->consecutive_ms);
+    x->maskingDecay=0.7;
+    x->maskingThreshold=4;
+    x->automaticThresholding = 0;
+    x->average_ms = config->average_ms > 0.0 ? config->average_ms : 0.0;
+    x->power = config->power != 0;
+    x->percentile = config->percentile < 0.0 || config->percentile > 100.0 ? -1.0 : config->percentile;
+    
+    for (int i = 0; x->channel != NULL && i < x->channels; i++)
+        x->channel[i].average = pod_stats_create(average_frames(x, x->average_ms), x->percentile);
+    
+    for (int i = 0; x->channel != NULL && i < x->channels; i++)
+    {
+        if (x->channel[i].average == NULL)
+        {
+            pod_destroy(x);
+            return NULL;
+        }
+    }
+    
+    if (x->arena == NULL || x->channel == NULL || x->fft_plan == NULL || x->tables == NULL)
+    {
+        pod_destroy(x);
+        return NULL;
+    }
+    
+    for (int i = 0; i < x->channels; i++)
+    {
+        x->channel[i].u_threshold = 1000;
+        x->channel[i].l_threshold = 10;
+        reset_channel(x, &x->channel[i]);
+    }
+    
+    if (config->latency > 0)
+        start_worker(x, config->latency);
+    
+    if (config->spread)
+        pod_set_spread(x, 1);
+    
+    if (config->engine != POD_ENGINE_FFT && pod_set_engine(x, config->engine) != 0)
+        pod_log(x, "The sliding dft and the filterbank do not run with a worker thread or spreading. Using the fft.");
+        
+    int resolutions = 0;
+    while (resolutions < POD_MAX_RESOLUTIONS - 1 && config->resolutions[resolutions] > 0)
+        resolutions++;
+        
+    if (resolutions > 0 && pod_set_resolutions(x, config->resolutions, resolutions) != 0)
+        pod_log(x, "Extra resolutions have to be powers of two from 64 up to below the window size, and only run with the fft engine and no spreading. Using one window.");
+    
+    x->phase_automatic = config->phase < 0;
+    x->phase = x->phase_automatic ? schedule_phase(x) : config->phase % x->hop_size;
+    x->dsp_tick = x->phase;
+    x->next = detectors;
+    detectors = x;
+    
+    return x;
+}
+
+static t_pod_tables* tables_acquire(int window_type, int window_size, float sample_rate)
+{
+    t_pod_tables* tables;
+    
+    for (tables = shared_tables; tables != NULL; tables = tables->next)
+    {
+        if (tables->window_type == window_type && tables->window_size == window_size && tables->sample_rate == sample_rate)
+        {
+            tables->refcount++;
+            return tables;
+        }
+    }
+    
+    tables = (t_pod_tables *)calloc(1, sizeof(t_pod_tables));
+    if (tables == NULL)
+        return NULL;
+        
+    tables->window_type = window_type;
+    tables->window_size = window_size;
+    tables->sample_rate = sample_rate;
+    tables->window = pod_fft_alloc(window_size);
+    
+    if (tables->window != NULL)
+        create_window(tables);
+    create_filterbank(tables);
+    
+    if (tables->window == NULL || tables->weights == NULL)
+    {
+        pod_fft_free(tables->window);
+        pod_fft_free(tables->weights);
+        free(tables);
+        return NULL;
+    }
+    
+    tables->refcount = 1;
+    tables->next = shared_tables;
+    shared_tables = tables;
+    return tables;
+}
+
+static void tables_release(t_pod_tables* tables)
+{
+    if (tables == NULL || --tables->refcount > 0)
+        return;
+        
+    for (t_pod_tables** t = &shared_tables; *t != NULL; t = &(*t)->next)
+    {
+        if (*t == tables)
+        {
+            *t = tables->next;
+            break;
+        }
+    }
+    
+    pod_fft_free(tables->window);
+    pod_fft_free(tables->weights);
+    free(tables);
+}
+
+static void create_window(t_pod_tables* tables)
+{
+    // The 1 / window_size fft normalization is folded into the window
+    double scale = 1.0 / tables->window_size;
+    
+    switch (tables->window_type) {
+        case 0:
+            // Hanning
+            for (int i = 0; i < tables->window_size; i++)
+                tables->window[i] = scale * 0.5 * (1 - cos((TWO_PI * i) / (tables->window_size - 1)));
+            break;
+            
+        case 1:
+            // Hamming
+            for (int i = 0; i < tables->window_size; i++)
+                tables->window[i] = scale * (0.54 - 0.46 * (cos((TWO_PI * i) / (tables->window_size - 1))));
+            break;
+    }
+}
+
+static void create_filterbank(t_pod_tables* tables)
+{
+    int half_window_size = tables->window_size / 2;
+    int num_weights = 0;
+    float period = tables->sample_rate / tables->window_size;
+    float length, slope, point;
+    
+    // Each band is a triangle rising from bark_ctr[i] to a peak at bark_ctr[i + 1] and falling to bark_ctr[i + 2].
+    // Only the bins under the triangle are stored, so the per-frame kernel never touches a zero weight.
+    for (int i = 0; i < NUM_BARKS; i++)
+    {
+        int start = 0;
+        
+        while (start < half_window_size && period * start < bark_ctr[i])
+            start++;
+            
+        int end = start;
+        while (end < half_window_size && period * end < bark_ctr[i + 2])
+            end++;
+            
+        tables->bands[i].start = start;
+        tables->bands[i].length = end - start;
+        num_weights += end - start;
+    }
+    
+    tables->weights = pod_fft_alloc(num_weights > 0 ? num_weights : 1);
+    if (tables->weights == NULL)
+        return;
+    
+    // NUM_BARKS is still 24, but we have an array of length 26, so we've added lower and upper limits
+    float* weights = tables->weights;
+    for (int i = 0; i < NUM_BARKS; i++)
+    {
+        t_bark_band* band = &tables->bands[i];
+        band->weights = weights;
+        
+        for (int j = 0; j < band->length; j++)
+        {
+            float frequency = period * (band->start + j);
+            
+            if (frequency < bark_ctr[i + 1])
+            {
+                slope = 1.0 / (bark_ctr[i + 1] - bark_ctr[i]);
+            }
+            else
+            {
+                length = bark_ctr[i + 2] - bark_ctr[i + 1];
+                slope = -1.0 / length;
+            }
+            
+            point = 1 - slope * bark_ctr[i + 1];
+            band->weights[j] = slope * frequency + point;                   // y = mx + b
+        }
+        
+        weights += band->length;
+        
+        if (band->start + band->length > tables->bins)
+            tables->bins = band->start + band->length;
+    }
+}
+
+// Swaps in tables, and the sliding dft sized for their filterbank when one is given, which it is when the
+// sliding dft engine runs and the filterbank changes size. Nothing may still be reading the old ones, so the
+// frame in progress and every frame out on the worker are finished first.
+static void use_tables(t_pod* x, t_pod_tables* tables, t_pod_sdft* sdft)
+{
+    finish_frame(x);
+    drain_worker(x);
+    
+    tables_release(x->tables);
+    x->tables = tables;
+    
+    if (sdft != NULL)
+    {
+        pod_sdft_destroy(x->sdft);
+        x->sdft = sdft;
+    }
+    
+    if (x->engine == POD_ENGINE_SDFT)
+        load_sdft(x);
+        
+    refresh_resolutions(x);
+}
+
+static t_pod_sdft* create_sdft(t_pod* x, const t_pod_tables* tables)
+{
+    // The sliding dft only follows the bins under the filterbank, plus one above for the window
+    return pod_sdft_create(tables->window_size, tables->bins + 1, x->channels);
+}
+
+// Everything sized by the window or the hop is made again here, and all of it is made before anything is
+// swapped, so a failure leaves the detector as it was. The swap happens between frames and carries the
+// latest history over, so the first frame at the new size is already a full one.
+static int resize_analysis(t_pod* x, int window_size, int hop_size)
+{
+    int channels = x->channels;
+    int history_size = window_size;
+    int keep, failed;
+    float* frames[POD_MAX_LATENCY + 1] = { NULL };
+    float* worker_arena = NULL;
+    t_pod_scratch worker_scratch;
+    t_pod_sdft* sdft = NULL;
+    t_pod_layout layout;
+    
+    while (history_size < window_size + hop_size)
+        history_size *= 2;
+        
+    arena_layout(&layout, x, window_size, history_size);
+    float* arena = pod_fft_alloc(layout.size);
+    t_pod_fft_plan* fft_plan = pod_fft_plan_acquire(window_size);
+    t_pod_tables* tables = tables_acquire(x->tables->window_type, window_size, x->sample_rate);
+    
+    if (tables != NULL && x->engine == POD_ENGINE_SDFT)
+        sdft = create_sdft(x, tables);
+        
+    failed = arena == NULL || fft_plan == NULL || tables == NULL || (x->engine == POD_ENGINE_SDFT && sdft == NULL);
+    
+    if (x->latency > 0)
+    {
+        for (int i = 0; i <= x->latency; i++)
+        {
+            frames[i] = pod_fft_alloc(window_size * channels);
+            failed |= frames[i] == NULL;
+        }
+        
+        worker_arena = make_scratch(&worker_scratch, window_size, channels);
+        failed |= worker_arena == NULL;
+    }
+    
+    if (failed)
+    {
+        pod_fft_free(arena);
+        pod_fft_plan_release(fft_plan);
+        pod_sdft_destroy(sdft);
+        tables_release(tables);
+        for (int i = 0; i <= x->latency; i++)
+            pod_fft_free(frames[i]);
+        pod_fft_free(worker_arena);
+        return -1;
+    }
+    
+    finish_frame(x);
+    drain_worker(x);
+    
+    // the newest frames go at the end, so the next write lands on the oldest one
+    keep = history_size < x->history_size ? history_size : x->history_size;
+    for (int i = 0; i < keep; i++)
+    {
+        int from = (x->write_index - keep + i) & (x->history_size - 1);
+        memcpy(arena + layout.signal + (history_size - keep + i) * channels, x->signal + from * channels,
+               channels * sizeof(float));
+    }
+    
+    // the start of the history repeated after its end, see mirror_history
+    memcpy(arena + layout.signal + history_size * channels, arena + layout.signal, window_size * channels * sizeof(float));
+    
+    // the ear filter carries on where it was
+    memcpy(arena + layout.filter_state, x->filter_state,
+           pod_sos_channel_state_size(&x->ear_filter, channels) * sizeof(float));
+           
+    pod_fft_free(x->arena);
+    pod_fft_plan_release(x->fft_plan);
+    
+    x->arena = arena;
+    use_arena(x, arena, &layout);
+    x->fft_plan = fft_plan;
+    
+    if (x->latency > 0)
+    {
+        for (int i = 0; i <= x->latency; i++)
+        {
+            pod_fft_free(x->frames[i].signal);
+            x->frames[i].signal = frames[i];
+        }
+        
+        pod_fft_free(x->worker_arena);
+        x->worker_arena = worker_arena;
+        x->worker_scratch = worker_scratch;
+    }
+    
+    x->window_size = window_size;
+    x->half_window_size = window_size / 2;
+    x->hop_size = hop_size;
+    x->history_size = history_size;
+    x->write_index = 0;
+    x->kernels = select_kernels(kernel_isa, channels);
+    
+    use_tables(x, tables, sdft);
+    
+    // the hop sets how many frames every time in ms covers, and where the phase falls; the scheduler picks
+    // again for a phase it picked, since the other detectors' load looks different from the new hop
+    x->consecutive_onset_filtering_threshold = consecutive_frames(x, x->consecutive_ms);
+    if (x->average_ms > 0.0)
+        pod_set_average_window(x, x->average_ms);
+    pod_set_phase(x, x->phase_automatic ? -1 : x->phase);
+    
+    return 0;
+}
+
+static void arena_layout(t_pod_layout* layout, const t_pod* x, int window_size, int history_size)
+{
+    int offset = 0;
+    
+    // the ear filter and the history every block, then a frame from its window to its bands
+    layout->filter_state = arena_carve(&offset, pod_sos_channel_state_size(&x->ear_filter, x->channels));
+    layout->signal = arena_carve(&offset, (history_size + window_size) * x->channels);
+    layout->analysis = arena_carve(&offset, window_size);
+    layout->spectrum = arena_carve(&offset, window_size + 2);
+    layout->fft_work = arena_carve(&offset, window_size);
+    layout->magnitudes = arena_carve(&offset, window_size / 2 * x->channels);
+    layout->band_sums = arena_carve(&offset, x->channels);
+    layout->bark_bins = arena_carve(&offset, NUM_BARKS * x->channels);
+    layout->bark_frame = arena_carve(&offset, NUM_BARKS * x->channels);
+    layout->size = offset;
+}
+
+static int arena_carve(int* offset, int count)
+{
+    int start = *offset;
+    
+    *offset += (count + ARENA_LINE - 1) / ARENA_LINE * ARENA_LINE;
+    return start;
+}
+
+static void use_arena(t_pod* x, float* arena, const t_pod_layout* layout)
+{
+    x->filter_state = arena + layout->filter_state;
+    x->signal = arena + layout->signal;
+    x->scratch.analysis = arena + layout->analysis;
+    x->scratch.spectrum = arena + layout->spectrum;
+    x->scratch.fft_work = arena + layout->fft_work;
+    x->scratch.magnitudes = arena + layout->magnitudes;
+    x->scratch.band_sums = arena + layout->band_sums;
+    x->scratch.bark_bins = arena + layout->bark_bins;
+    x->bark_frame = arena + layout->bark_frame;
+}
+
+static int make_resolution(t_pod* x, t_pod_resolution* r, int window_size)
+{
+    memset(r, 0, sizeof(t_pod_resolution));
+    r->window_size = window_size;
+    r->kernels = select_kernels(kernel_isa, x->channels);
+    r->fft_plan = pod_fft_plan_acquire(window_size);
+    r->tables = tables_acquire(x->tables->window_type, window_size, x->tables->sample_rate);
+    
+    if (r->fft_plan == NULL || r->tables == NULL)
+    {
+        free_resolution(r);
+        return -1;
+    }
+    
+    return 0;
+}
+
+static void free_resolution(t_pod_resolution* r)
+{
+    pod_fft_plan_release(r->fft_plan);
+    tables_release(r->tables);
+    memset(r, 0, sizeof(t_pod_resolution));
+}
+
+// Each band comes from the shortest window that puts at least MIN_BAND_BINS bins under it and every band
+// above, the rest from the main window. Bands widen going up, so every window gets one run of them.
+static void assign_bands(t_pod* x)
+{
+    int last = NUM_BARKS;
+    
+    for (int i = x->num_resolutions - 1; i >= 0; i--)
+    {
+        t_pod_resolution* r = &x->resolutions[i];
+        int first = last;
+        
+        while (first > 0 && r->tables->bands[first - 1].length >= MIN_BAND_BINS)
+            first--;
+            
+        r->first_band = first;
+        r->last_band = last;
+        r->from_bin = first < last ? r->tables->bands[first].start : 0;
+        r->bins = first < last ? r->tables->bands[last - 1].start + r->tables->bands[last - 1].length : 0;
+        last = first;
+    }
+    
+    x->low_bands = last;
+    x->low_bins = 0;
+    for (int i = 0; i < last; i++)
+        if (x->tables->bands[i].start + x->tables->bands[i].length > x->low_bins)
+            x->low_bins = x->tables->bands[i].start + x->tables->bands[i].length;
+}
+
+// After the main window's tables change: the same resolutions again for the new window type and sample rate,
+// less any no longer shorter than the window
+static void refresh_resolutions(t_pod* x)
+{
+    int sizes[POD_MAX_RESOLUTIONS - 1];
+    int count = 0;
+    
+    for (int i = 0; i < x->num_resolutions; i++)
+        if (x->resolutions[i].window_size < x->window_size)
+            sizes[count++] = x->resolutions[i].window_size;
+            
+    if (pod_set_resolutions(x, sizes, count) != 0)
+    {
+        pod_set_resolutions(x, sizes, 0);
+        pod_log(x, "Out of memory for the extra resolutions. Using one window.");
+    }
+}
+
+#pragma mark - Perform -
+
+void pod_process_block(t_pod* x, const float* in1, int n)
+{
+    pod_process_channels(x, &in1, n);
+}
+
+void pod_process_channels(t_pod* x, const float* const* in, int n)
+{
+    int mask = x->history_size - 1;             // history size is always a power of two
+    int first = x->history_size - x->write_index;
+    int start = x->write_index;
+    
+    // A block longer than the hop runs in pieces that each end on the sample the next frame falls due, so
+    // every frame in it is analysed. The filterbank keeps to the hop by itself and only needs pieces short
+    // enough to fit the spare history, which the hop always does, as does the sliding dft's need for the
+    // samples leaving the window.
+    int limit = x->engine == POD_ENGINE_BANK ? x->history_size - x->window_size : x->hop_size;
+    
+    if (n > limit)
+    {
+        const float* piece[x->channels];
+        
+        for (int done = 0, part; done < n; done += part)
+        {
+            part = x->engine == POD_ENGINE_BANK ? limit : x->hop_size - x->dsp_tick;
+            if (part > n - done)
+                part = n - done;
+                
+            for (int i = 0; i < x->channels; i++)
+                piece[i] = in[i] + done;
+            pod_process_channels(x, piece, part);
+        }
+        return;
+    }
+    
+    // A spread frame gets one slice a block, but has to be done before this block makes the next one due
+    if (x->slice_stage != SLICE_IDLE)
+    {
+        if (x->dsp_tick + n >= x->hop_size)
+            finish_frame(x);
+        else
+            run_slice(x);
+    }
+    
+    PROFILE_START();
+    
+    if (first > n)
+        first = n;
+    
+    // This filters the whole block and writes it over the oldest samples in the circular buffer. One channel
+    // runs through the block kernel; several run side by side, one per vector lane.
+    if (x->channels == 1)
+    {
+        pod_sos_process(&x->ear_filter, in[0], x->signal + x->write_index, first);
+        if (first < n)
+            pod_sos_process(&x->ear_filter, in[0] + first, x->signal, n - first);
+    }
+    else
+    {
+        pod_sos_process_channels(&x->ear_filter, x->filter_state, x->channels, in, 0,
+                                 x->signal + x->write_index * x->channels, first);
+        if (first < n)
+            pod_sos_process_channels(&x->ear_filter, x->filter_state, x->channels, in, first, x->signal, n - first);
+    }
+    
+    mirror_history(x, start, start + first);
+    if (first < n)
+        mirror_history(x, 0, n - first);
+    
+    x->write_index = (x->write_index + n) & mask;
+    
+    PROFILE_STAGE(&x->profile, POD_STAGE_EAR_FILTER);
+    
+    if (x->engine == POD_ENGINE_SDFT)
+    {
+        pod_sdft_update(x->sdft, x->signal, x->history_size, start, n);
+        
+        // start again from an exact spectrum once a window before rounding can add up
+        x->sdft_count += n;
+        if (x->sdft_count >= x->window_size)
+            load_sdft(x);
+        
+        PROFILE_STAGE(&x->profile, POD_STAGE_FFT);
+    }
+#ifdef POD_PROFILE
+    x->profile.samples += n;
+#endif
+    
+    // The filters can be read at any sample, so a hop shorter than the block still gets every one of its frames
+    if (x->engine == POD_ENGINE_BANK)
+    {
+        run_bank(x, start, n);
+        return;
+    }
+    
+    // Increase the dsp_tick variable by the number of samples passed to callback
+    x->dsp_tick += n;
+    x->sample_count += n;
+    
+    // If the dsp_tick reaches the hop_size value, then we do our processing
+    if (x->dsp_tick >= x->hop_size)
+    {
+        // Keep what the block ran past the due sample, so frames stay on the phase whatever the block size,
+        // and end the window on that sample. The sliding bins only exist for the end of the block.
+        int late = x->engine == POD_ENGINE_SDFT ? 0 : x->dsp_tick % x->hop_size;
+        int oldest = (x->write_index - late - x->window_size) & mask;
+        long long due = x->sample_count - late;
+        
+        x->dsp_tick %= x->hop_size;
+        
+        if (x->engine == POD_ENGINE_SDFT)
+        {
+            sdft_frame(x, x->bark_frame);
+            detect_onsets(x, x->bark_frame, x->sample_count);
+        }
+        else if (x->latency > 0)
+        {
+            // pick the frame from latency hops ago, saying so once each time the worker falls behind
+            if (x->frames_sent - x->frames_received == x->latency)
+            {
+                int missed = receive_frame(x);
+                
+                if (missed && ! x->worker_behind)
+                    pod_log(x, "The worker thread fell a whole latency behind. Analysing late frames on the calling thread.");
+                x->worker_behind = missed;
+            }
+            send_frame(x, oldest, due);
+        }
+        else if (x->spread)
+        {
+            // start on it next block
+            x->slice_stage = SLICE_WINDOW;
+            x->slice_channel = 0;
+            x->slice_position = 0;
+            x->slice_oldest = oldest;
+            x->slice_sample = due;
+        }
+        else
+        {
+            analyze_frame(x, &x->scratch, x->signal + oldest * x->channels, x->bark_frame, PROFILE_OF(x));
+            detect_onsets(x, x->bark_frame, due);
+        }
+    }
+}
+
+// The history holds window_size frames past its end that repeat its start, so every frame is one contiguous
+// run and the windowing never has to wrap. Called for whatever part of [from, to) the ear filter just wrote.
+static void mirror_history(t_pod* x, int from, int to)
+{
+    if (to > x->window_size)
+        to = x->window_size;
+        
+    if (from < to)
+        memcpy(x->signal + (x->history_size + from) * x->channels, x->signal + from * x->channels,
+               (to - from) * x->channels * sizeof(float));
+}
+
+// Window, fft, magnitudes, Bark bands and loudness for every channel of one frame, window_size interleaved
+// frames oldest first. Writes only scratch and bark_bins and touches nothing the peak picking uses, so it can
+// run on the worker thread.
+static void analyze_frame(t_pod* x, const t_pod_scratch* scratch, const float* frame, float* bark_bins,
+                          t_pod_profile* profile)
+{
+    int channels = x->channels;
+    
+    PROFILE_START();
+    
+    for (int channel = 0; channel < channels && x->low_bands > 0; channel++)
+    {
+        x->kernels->window(scratch->analysis, frame + channel, x->tables->window, channels, x->window_size);
+        
+        PROFILE_STAGE(profile, POD_STAGE_WINDOW);
+        
+        // take fft, already scaled by the window
+        pod_fft_forward(x->fft_plan, scratch->analysis, scratch->spectrum, scratch->fft_work);
+        
+        PROFILE_STAGE(profile, POD_STAGE_FFT);
+        
+        magnitude_channel(x, scratch, channel, 0, x->low_bins);
+        
+        PROFILE_STAGE(profile, POD_STAGE_MAGNITUDE);
+    }
+    
+    // weight the magnitudes of every channel by the filterbank and sum them into bark bins (1 x half_windowsize vector -> 1 x 24 vector)
+    condense_analysis(x, scratch, bark_bins);
+    
+    PROFILE_STAGE(profile, POD_STAGE_BARK);
+    
+    // the shorter windows end on the same sample and overwrite the bands they supply
+    for (int i = 0; i < x->num_resolutions; i++)
+        analyze_resolution(x, &x->resolutions[i], scratch,
+                           frame + (x->window_size - x->resolutions[i].window_size) * channels, bark_bins, profile);
+        
+    PROFILE_RESTART();
+    
+    // multiply by loudness curves
+    for (int channel = 0; channel < channels; channel++)
+        multiply_loudness(bark_bins + channel * NUM_BARKS);
+    
+    PROFILE_STAGE(profile, POD_STAGE_LOUDNESS);
+}
+
+static void analyze_resolution(t_pod* x, t_pod_resolution* r, const t_pod_scratch* scratch, const float* frame,
+                               float* bark_bins, t_pod_profile* profile)
+{
+    int channels = x->channels;
+    
+    if (r->first_band == r->last_band)
+        return;
+        
+    PROFILE_START();
+    
+    for (int channel = 0; channel < channels; channel++)
+    {
+        r->kernels->window(scratch->analysis, frame + channel, r->tables->window, channels, r->window_size);
+        
+        PROFILE_STAGE(profile, POD_STAGE_WINDOW);
+        
+        pod_fft_forward(r->fft_plan, scratch->analysis, scratch->spectrum, scratch->fft_work);
+        
+        PROFILE_STAGE(profile, POD_STAGE_FFT);
+        
+        pod_fft_magnitudes(scratch->spectrum, scratch->magnitudes + channel, channels, r->from_bin, r->bins, x->power);
+        
+        PROFILE_STAGE(profile, POD_STAGE_MAGNITUDE);
+    }
+    
+    r->kernels->bands(r->tables->bands, scratch->magnitudes, channels, scratch->band_sums, scratch->bark_bins);
+    for (int channel = 0; channel < channels; channel++)
+        memcpy(bark_bins + channel * NUM_BARKS + r->first_band, scratch->bark_bins + channel * NUM_BARKS + r->first_band,
+               (r->last_band - r->first_band) * sizeof(float));
+               
+    PROFILE_STAGE(profile, POD_STAGE_BARK);
+}
+
+static void window_channel(t_pod* x, const float* frame, int channel, int from, int to)
+{
+    int channels = x->channels;
+    
+    // analysis is windowed signal
+    x->kernels->window(x->scratch.analysis + from, frame + from * channels + channel, x->tables->window + from, channels,
+                       to - from);
+}
+
+static void magnitude_channel(t_pod* x, const t_pod_scratch* scratch, int channel, int from, int to)
+{
+    float* magnitudes = scratch->magnitudes + channel;
+    
+    // Get the magnitude (or power) of every bin the bands read, leaving DC at zero
+    if (from == 0)
+        magnitudes[from++] = 0.0;
+        
+    pod_fft_magnitudes(scratch->spectrum, magnitudes, x->channels, from, to, x->power);
+}
+
+static void run_slice(t_pod* x)
+{
+    int end;
+    
+    PROFILE_START();
+    
+    switch (x->slice_stage) {
+            
+        case SLICE_WINDOW:
+            end = x->slice_position + SLICE_SIZE < x->window_size ? x->slice_position + SLICE_SIZE : x->window_size;
+            window_channel(x, x->signal + x->slice_oldest * x->channels, x->slice_channel, x->slice_position, end);
+            x->slice_position = end;
+            if (end == x->window_size)
+                x->slice_stage = SLICE_FFT;
+            
+            PROFILE_STAGE(&x->profile, POD_STAGE_WINDOW);
+            break;
+            
+        case SLICE_FFT:
+            pod_fft_forward(x->fft_plan, x->scratch.analysis, x->scratch.spectrum, x->scratch.fft_work);
+            x->slice_stage = SLICE_MAGNITUDE;
+            x->slice_position = 0;
+            
+            PROFILE_STAGE(&x->profile, POD_STAGE_FFT);
+            break;
+            
+        case SLICE_MAGNITUDE:
+            end = x->slice_position + SLICE_SIZE < x->tables->bins ? x->slice_position + SLICE_SIZE : x->tables->bins;
+            magnitude_channel(x, &x->scratch, x->slice_channel, x->slice_position, end);
+            x->slice_position = end;
+            if (end == x->tables->bins)
+            {
+                x->slice_position = 0;
+                x->slice_stage = ++x->slice_channel < x->channels ? SLICE_WINDOW : SLICE_BANDS;
+            }
+            
+            PROFILE_STAGE(&x->profile, POD_STAGE_MAGNITUDE);
+            break;
+            
+        case SLICE_BANDS:
+            condense_analysis(x, &x->scratch, x->bark_frame);
+            
+            PROFILE_STAGE(&x->profile, POD_STAGE_BARK);
+            
+            for (int channel = 0; channel < x->channels; channel++)
+                multiply_loudness(x->bark_frame + channel * NUM_BARKS);
+            
+            PROFILE_STAGE(&x->profile, POD_STAGE_LOUDNESS);
+            
+            x->slice_stage = SLICE_IDLE;
+            detect_onsets(x, x->bark_frame, x->slice_sample);
+            break;
+    }
+}
+
+static void finish_frame(t_pod* x)
+{
+    while (x->slice_stage != SLICE_IDLE)
+        run_slice(x);
+}
+
+// Magnitudes from the sliding bins, then the same bands and loudness as analyze_frame
+static void sdft_frame(t_pod* x, float* bark_bins)
+{
+    float a0, a1;
+    
+    PROFILE_START();
+    
+    raised_cosine(x->tables->window_type, &a0, &a1);
+    for (int channel = 0; channel < x->channels; channel++)
+        pod_sdft_magnitudes(x->sdft, channel, a0, a1, x->scratch.magnitudes + channel, x->channels, x->power);
+    
+    PROFILE_STAGE(&x->profile, POD_STAGE_MAGNITUDE);
+    
+    condense_analysis(x, &x->scratch, bark_bins);
+    
+    PROFILE_STAGE(&x->profile, POD_STAGE_BARK);
+    
+    for (int channel = 0; channel < x->channels; channel++)
+        multiply_loudness(bark_bins + channel * NUM_BARKS);
+    
+    PROFILE_STAGE(&x->profile, POD_STAGE_LOUDNESS);
+}
+
+static void load_sdft(t_pod* x)
+{
+    int oldest = (x->write_index - x->window_size) & (x->history_size - 1);
+    
+    // An unwindowed, unscaled fft of the latest window of every channel
+    for (int channel = 0; channel < x->channels; channel++)
+    {
+        for (int i = 0; i < x->window_size; i++)
+            x->scratch.analysis[i] = x->signal[((oldest + i) & (x->history_size - 1)) * x->channels + channel];
+        
+        pod_fft_forward(x->fft_plan, x->scratch.analysis, x->scratch.spectrum, x->scratch.fft_work);
+        pod_sdft_load(x->sdft, channel, x->scratch.spectrum);
+    }
+    
+    x->sdft_count = 0;
+}
+
+// Runs the n filtered samples from start through the filters a hop at a time, with a frame at the end of each
+static void run_bank(t_pod* x, int start, int n)
+{
+    while (n > 0)
+    {
+        int part = x->hop_size - x->dsp_tick;
+        
+        if (part > n)
+            part = n;
+        if (part < 1)
+            part = 1;
+            
+        PROFILE_START();
+        
+        pod_bank_update(x->bank, x->signal, x->history_size, start, part);
+        
+        PROFILE_STAGE(&x->profile, POD_STAGE_BARK);
+        
+        start = (start + part) & (x->history_size - 1);
+        n -= part;
+        x->dsp_tick += part;
+        x->sample_count += part;
+        
+        if (x->dsp_tick >= x->hop_size)
+        {
+            x->dsp_tick = 0;
+            bank_frame(x, x->bark_frame);
+            detect_onsets(x, x->bark_frame, x->sample_count);
+        }
+    }
+}
+
+// The filters' envelopes as they stand, then the same loudness as analyze_frame. The bands are already
+// summed, so a frame is only this whatever the hop.
+static void bank_frame(t_pod* x, float* bark_bins)
+{
+    PROFILE_START();
+    
+    for (int channel = 0; channel < x->channels; channel++)
+        pod_bank_envelopes(x->bank, channel, bark_bins + channel * NUM_BARKS, x->power);
+        
+    PROFILE_STAGE(&x->profile, POD_STAGE_BARK);
+    
+    for (int channel = 0; channel < x->channels; channel++)
+        multiply_loudness(bark_bins + channel * NUM_BARKS);
+        
+    PROFILE_STAGE(&x->profile, POD_STAGE_LOUDNESS);
+}
+
+static t_pod_bank* create_bank(t_pod* x, float sample_rate)
+{
+    // band i lies between bark_lim[i] and bark_lim[i + 1], centred on bark_ctr[i + 1] like its triangle
+    return pod_bank_create(bark_lim, bark_ctr + 1, sample_rate, x->channels);
+}
+
+static void raised_cosine(int window_type, float* a0, float* a1)
+{
+    // Periodic hanning or hamming as a0 - 2 a1 cos(2 pi i / N), which is a three bin kernel on the spectrum
+    if (window_type == 1)
+    {
+        *a0 = 0.54;
+        *a1 = 0.23;
+    }
+    else
+    {
+        *a0 = 0.5;
+        *a1 = 0.25;
+    }
+}
+
+// Spectral flux and peak picking for a frame analysed from the history at sample
+static void detect_onsets(t_pod* x, const float* bark_bins, long long sample)
+{
+    PROFILE_START();
+    
+    x->frame_sample = sample;
+    
+    for (int channel = 0; channel < x->channels; channel++)
+    {
+        t_pod_channel* c = &x->channel[channel];
+        
+        memcpy(c->bark_bins, bark_bins + channel * NUM_BARKS, sizeof(c->bark_bins));
+        
+        //subtract this frame from last to get to our feature space
+        c->bark_difference = accumulate_bin_differences(x, c, channel);
+        
+        PROFILE_STAGE(&x->profile, POD_STAGE_FLUX);
+        
+        pick_peaks(x, c, channel);
+        
+        PROFILE_STAGE(&x->profile, POD_STAGE_PEAK_PICKING);
+    }
+    
+#ifdef POD_PROFILE
+    x->profile.frames++;
+#endif
+}
+
+static void pick_peaks(t_pod* x, t_pod_channel* c, int channel)
+{
+    // -- spectral flux peak picking -- //
+    
+    //masking
+    if (c->maskFlag == 1) {
+        if (c->maskIterator == x->maskingThreshold) {
+            c->maskFlag = 0;
+            c->maskIterator =0;
+        }
+        else
+            for (int i =0; i<x->maskingThreshold-c->maskIterator; i++){
+                c->bark_difference = c->bark_difference * x->maskingThreshold;
+            }
+        c->maskIterator ++;
+    }
+    
+    
+    //Consecutive onset filtering
+    if (c->consecutive_onset_flag == 1) {
+        if (c->consecutive_onset_filtering_iterator > x->consecutive_onset_filtering_threshold) {
+            c->consecutive_onset_flag = 0;
+            c->consecutive_onset_filtering_iterator = 0;
+        }
+        else c->consecutive_onset_filtering_iterator++;
+    }
+    
+    //Is our flag raised?
+    switch (c->flag) {
+            
+        case 0: //Flag is down.
+            
+            //Lets check if we're above the upper threshold
+            if (c->bark_difference > c->u_threshold) {
+                
+                if (c->consecutive_onset_flag == 0) {
+                    
+                //Let's flag this spot for a potential onset and hang on to that peak value if it ends up being one
+                c->flag = 1;
+                c->debounce_iterator = 1;
+                c->peak_value=c->bark_difference;
+                c->peak_sample = x->frame_sample;
+                    
+                }
+            }
+            
+            //otherwise, we'll keep waiting for an onset.
+            
+            break;
+            
+        case 1: //Flag is up.
+            
+                
+            //did we go even higher above the threshold?
+            if (c->bark_difference > c->peak_value) {
+                
+                if (c->consecutive_onset_flag == 0) {
+                    
+                //flag this as a better estimate for the onset.
+                c->flag = 1;
+                c->debounce_iterator = 1;
+                c->peak_value = c->bark_difference;
+                c->peak_sample = x->frame_sample;
+                    
+                }
+                
+            }
+            
+            //if not...
+            else{
+                
+                //Have we gone beyond our debouncing window?
+                if (c->debounce_iterator > x->debounce_threshold) {
+                    
+                    if (c->consecutive_onset_flag == 0) {
+
+                    //onset verified!
+                    report_onset(x, c, channel);
+                    pod_log(x, "onset: debounce window exceeded");
+                    
+                    c->debounce_iterator = 0;
+                    c->flag = 0;
+                    c->consecutive_onset_flag=1;
+                    c->maskFlag = 1;
+                        
+                    }
+                    
+                    //else post("consecutive onset ignored");
+                    
+                }
+                
+                else{
+                    
+                    //are we below our lower threshold?
+                    if(c->bark_difference < c->l_threshold){
+                        
+                        if (c->consecutive_onset_flag == 0) {
+                            
+                        //onset verified!
+                        report_onset(x, c, channel);
+                        //pod_log(x, "onset: lower threshold");
+                        
+                        c->debounce_iterator = 0;
+                        c->flag = 0;
+                        c->consecutive_onset_flag=1;
+                        c->maskFlag = 1;
+                        
+                        }
+                        
+                        //else post("consecutive onset ignored");
+                        
+                    }
+                    
+                    //we have a peak flagged, but we haven't increased or crossed the lower threshold yet.
+                    //Lets wait a bit longer to make sure our tagged peak is an onset
+                    else c->debounce_iterator++;
+                }
+                
+                
+            }
+            
+            break;
+    }
+    
+    
+    if (x->automaticThresholding == 1) 
+    {
+        float level;
+        
+        pod_stats_add(c->average, c->bark_difference);
+        level = x->percentile < 0.0 ? pod_stats_mean(c->average) : pod_stats_percentile(c->average);
+        
+        c->u_threshold = level * x->upper_threshold_scale;
+        c->l_threshold = level * x->lower_threshold_scale;
+
+    }
+    
+    iterate_bark_bins(c);
+}
+
+static void report_onset(t_pod* x, t_pod_channel* c, int channel)
+{
+    t_pod_onset onset;
+    
+    onset.channel = channel;
+    onset.sample = x->frame_sample;
+    onset.peak_sample = c->peak_sample;
+    onset.peak = c->peak_value;
+    
+    if (x->config.onset)
+        x->config.onset(x->config.user, &onset);
+}
+
+
+#pragma mark - Ear Filters -
+#pragma mark Outer and Middle Ear
+
+static void create_ear_filter(t_pod* x)
+{
+    pod_sos_init(&x->ear_filter);
+    
+    // Outer ear is a plain second-order section
+    pod_sos_add_section(&x->ear_filter, x->o_b0, x->o_b1, x->o_b2, x->o_a1, x->o_a2);
+    
+    // The middle ear feeds back its unscaled output through m_a2 and then scales the result by m_a2,
+    // which is the same as a section with every b scaled by m_a2 and a first-order feedback of m_a2
+    pod_sos_add_section(&x->ear_filter, x->m_a2 * x->m_b0, x->m_a2 * x->m_b1, x->m_a2 * x->m_b2, x->m_a2, 0.0);
+}
+
+#pragma mark Inner Ear
+
+static void condense_analysis(t_pod* x, const t_pod_scratch* scratch, float* bark_bins)
+{
+    x->kernels->bands(x->tables->bands, scratch->magnitudes, x->channels, scratch->band_sums, bark_bins);
+}
+
+static void multiply_loudness(float* bark_bins)
+{
+    for (int i = 0; i < NUM_BARKS; i++)
+        bark_bins[i] *= band_weightings[i];
+}
+
+
+#pragma mark - Kernels -
+
+// Each kernel has a variant per instruction set the compiler can target, compiled with that set enabled for the
+// one function, so the binary still loads on a processor without it. The helpers below are what differs
+// between sets; the kernels built from them, and the tables that hold them, are stamped out per set.
+
+#define TARGET_scalar
+#define TARGET_neon
+#if defined(POD_CPU_X86)
+#define TARGET_sse2 POD_TARGET("sse2")
+#define TARGET_avx2 POD_TARGET("avx2")
+#define TARGET_avx512 POD_TARGET("avx512f")
+#endif
+
+#pragma mark Scalar
+
+static inline void multiply_scalar(float* out, const float* frame, const float* window, int size)
+{
+    for (int i = 0; i < size; i++)
+        out[i] = frame[i] * window[i];
+}
+
+static inline float dot_scalar(const float* weights, const float* magnitudes, int length)
+{
+    float sum = 0.0;
+    
+    for (int j = 0; j < length; j++)
+        sum += weights[j] * magnitudes[j];
+        
+    return sum;
+}
+
+static float flux_scalar(const float* bark_bins, const float* prev_bark_bins)
+{
+    float diff = 0;
+    
+    for (int i = 0; i < NUM_BARKS; i++)
+        diff += halfwave_rectify(fabs(bark_bins[i]) - fabs(prev_bark_bins[i]));
+        
+    return diff;
+}
+
+static void window_strided_scalar(float* out, const float* frame, const float* window, int stride, int size)
+{
+    for (int i = 0; i < size; i++)
+        out[i] = frame[i * stride] * window[i];
+}
+
+// Sums one band for channels first onwards, and returns the first channel it left; here, none
+static inline int lanes_scalar(const t_bark_band* band, const float* magnitude, int channels, int first, float* sums)
+{
+    // Each weight is loaded once and applied to the same bin of every channel, which sit next to each other
+    for (int c = first; c < channels; c++)
+        sums[c] = 0.0;
+        
+    for (int j = 0; j < band->length; j++)
+    {
+        float weight = band->weights[j];
+        
+        for (int c = first; c < channels; c++)
+            sums[c] += weight * magnitude[c];
+            
+        magnitude += channels;
+    }
+    
+    return channels;
+}
+
+#if defined(POD_CPU_X86)
+#pragma mark SSE2
+
+TARGET_sse2 static inline float sum_sse2(__m128 v)
+{
+    float lanes[4];
+    
+    _mm_storeu_ps(lanes, v);
+    return (lanes[0] + lanes[1]) + (lanes[2] + lanes[3]);
+}
+
+TARGET_sse2 static inline void multiply_sse2(float* out, const float* frame, const float* window, int size)
+{
+    int i = 0;
+    
+    for (; i + 4 <= size; i += 4)
+        _mm_storeu_ps(out + i, _mm_mul_ps(_mm_loadu_ps(frame + i), _mm_loadu_ps(window + i)));
+        
+    for (; i < size; i++)
+        out[i] = frame[i] * window[i];
+}
+
+TARGET_sse2 static inline float dot_sse2(const float* weights, const float* magnitudes, int length)
+{
+    __m128 acc = _mm_setzero_ps();
+    int j = 0;
+    
+    for (; j + 4 <= length; j += 4)
+        acc = _mm_add_ps(acc, _mm_mul_ps(_mm_loadu_ps(weights + j), _mm_loadu_ps(magnitudes + j)));
+        
+    float sum = sum_sse2(acc);
+    for (; j < length; j++)
+        sum += weights[j] * magnitudes[j];
+        
+    return sum;
+}
+
+TARGET_sse2 static float flux_sse2(const float* bark_bins, const float* prev_bark_bins)
+{
+    // halfwave_rectify as it stands: v + |v| / 2
+    const __m128 sign = _mm_set1_ps(-0.0f);
+    const __m128 half = _mm_set1_ps(0.5f);
+    __m128 acc = _mm_setzero_ps();
+    
+    for (int i = 0; i < NUM_BARKS; i += 4)
+    {
+        __m128 v = _mm_sub_ps(_mm_andnot_ps(sign, _mm_loadu_ps(bark_bins + i)),
+                              _mm_andnot_ps(sign, _mm_loadu_ps(prev_bark_bins + i)));
+        acc = _mm_add_ps(acc, _mm_add_ps(v, _mm_mul_ps(_mm_andnot_ps(sign, v), half)));
+    }
+    
+    return sum_sse2(acc);
+}
+
+TARGET_sse2 static void window_strided_sse2(float* out, const float* frame, const float* window, int stride, int size)
+{
+    int i = 0;
+    
+    for (; i + 4 <= size; i += 4, frame += 4 * stride)
+    {
+        __m128 v = _mm_setr_ps(frame[0], frame[stride], frame[2 * stride], frame[3 * stride]);
+        _mm_storeu_ps(out + i, _mm_mul_ps(v, _mm_loadu_ps(window + i)));
+    }
+    
+    for (; i < size; i++, frame += stride)
+        out[i] = frame[0] * window[i];
+}
+
+// Channels four at a time, then a pair in the low half and a last one in the lowest lane, so none are left.
+// Every lane adds its bins in the scalar order.
+TARGET_sse2 static inline int lanes_sse2(const t_bark_band* band, const float* magnitude, int channels, int first, float* sums)
+{
+    int c = first;
+    
+    for (; c + 4 <= channels; c += 4)
+    {
+        const float* bin = magnitude + c;
+        __m128 acc = _mm_setzero_ps();
+        
+        for (int j = 0; j < band->length; j++, bin += channels)
+            acc = _mm_add_ps(acc, _mm_mul_ps(_mm_set1_ps(band->weights[j]), _mm_loadu_ps(bin)));
+            
+        _mm_storeu_ps(sums + c, acc);
+    }
+    
+    if (c + 2 <= channels)
+    {
+        const float* bin = magnitude + c;
+        __m128 acc = _mm_setzero_ps();
+        
+        for (int j = 0; j < band->length; j++, bin += channels)
+            acc = _mm_add_ps(acc, _mm_mul_ps(_mm_set1_ps(band->weights[j]), _mm_loadl_pi(_mm_setzero_ps(), (const __m64*)bin)));
+            
+        _mm_storel_pi((__m64*)(sums + c), acc);
+        c += 2;
+    }
+    
+    if (c < channels)
+    {
+        const float* bin = magnitude + c;
+        __m128 acc = _mm_setzero_ps();
+        
+        for (int j = 0; j < band->length; j++, bin += channels)
+            acc = _mm_add_ss(acc, _mm_mul_ss(_mm_set_ss(band->weights[j]), _mm_load_ss(bin)));
+            
+        _mm_store_ss(sums + c, acc);
+        c++;
+    }
+    
+    return c;
+}
+
+#pragma mark AVX2
+
+TARGET_avx2 static inline float sum_avx2(__m256 v)
+{
+    return sum_sse2(_mm_add_ps(_mm256_castps256_ps128(v), _mm256_extractf128_ps(v, 1)));
+}
+
+TARGET_avx2 static inline void multiply_avx2(float* out, const float* frame, const float* window, int size)
+{
+    int i = 0;
+    
+    for (; i + 8 <= size; i += 8)
+        _mm256_storeu_ps(out + i, _mm256_mul_ps(_mm256_loadu_ps(frame + i), _mm256_loadu_ps(window + i)));
+        
+    for (; i < size; i++)
+        out[i] = frame[i] * window[i];
+}
+
+TARGET_avx2 static inline float dot_avx2(const float* weights, const float* magnitudes, int length)
+{
+    __m256 acc = _mm256_setzero_ps();
+    int j = 0;
+    
+    for (; j + 8 <= length; j += 8)
+        acc = _mm256_add_ps(acc, _mm256_mul_ps(_mm256_loadu_ps(weights + j), _mm256_loadu_ps(magnitudes + j)));
+        
+    float sum = sum_avx2(acc);
+    for (; j < length; j++)
+        sum += weights[j] * magnitudes[j];
+        
+    return sum;
+}
+
+TARGET_avx2 static float flux_avx2(const float* bark_bins, const float* prev_bark_bins)
+{
+    // NUM_BARKS is a multiple of eight, so there is no tail
+    const __m256 sign = _mm256_set1_ps(-0.0f);
+    const __m256 half = _mm256_set1_ps(0.5f);
+    __m256 acc = _mm256_setzero_ps();
+    
+    for (int i = 0; i < NUM_BARKS; i += 8)
+    {
+        __m256 v = _mm256_sub_ps(_mm256_andnot_ps(sign, _mm256_loadu_ps(bark_bins + i)),
+                                 _mm256_andnot_ps(sign, _mm256_loadu_ps(prev_bark_bins + i)));
+        acc = _mm256_add_ps(acc, _mm256_add_ps(v, _mm256_mul_ps(_mm256_andnot_ps(sign, v), half)));
+    }
+    
+    return sum_avx2(acc);
+}
+
+TARGET_avx2 static void window_strided_avx2(float* out, const float* frame, const float* window, int stride, int size)
+{
+    const __m256i index = _mm256_mullo_epi32(_mm256_setr_epi32(0, 1, 2, 3, 4, 5, 6, 7), _mm256_set1_epi32(stride));
+    int i = 0;
+    
+    for (; i + 8 <= size; i += 8, frame += 8 * stride)
+        _mm256_storeu_ps(out + i, _mm256_mul_ps(_mm256_i32gather_ps(frame, index, 4), _mm256_loadu_ps(window + i)));
+        
+    for (; i < size; i++, frame += stride)
+        out[i] = frame[0] * window[i];
+}
+
+TARGET_avx2 static inline int lanes_avx2(const t_bark_band* band, const float* magnitude, int channels, int first, float* sums)
+{
+    int c = first;
+    
+    for (; c + 8 <= channels; c += 8)
+    {
+        const float* bin = magnitude + c;
+        __m256 acc = _mm256_setzero_ps();
+        
+        for (int j = 0; j < band->length; j++, bin += channels)
+            acc = _mm256_add_ps(acc, _mm256_mul_ps(_mm256_set1_ps(band->weights[j]), _mm256_loadu_ps(bin)));
+            
+        _mm256_storeu_ps(sums + c, acc);
+    }
+    
+    return lanes_sse2(band, magnitude, channels, c, sums);
+}
+
+#pragma mark AVX-512
+
+// The tails are masked loads and stores rather than a scalar loop
+
+TARGET_avx512 static inline void multiply_avx512(float* out, const float* frame, const float* window, int size)
+{
+    int i = 0;
+    
+    for (; i + 16 <= size; i += 16)
+        _mm512_storeu_ps(out + i, _mm512_mul_ps(_mm512_loadu_ps(frame + i), _mm512_loadu_ps(window + i)));
+        
+    if (i < size)
+    {
+        __mmask16 mask = (__mmask16)((1u << (size - i)) - 1);
+        _mm512_mask_storeu_ps(out + i, mask, _mm512_mul_ps(_mm512_maskz_loadu_ps(mask, frame + i),
+                                                           _mm512_maskz_loadu_ps(mask, window + i)));
+    }
+}
+
+TARGET_avx512 static inline float dot_avx512(const float* weights, const float* magnitudes, int length)
+{
+    __m512 acc = _mm512_setzero_ps();
+    int j = 0;
+    
+    for (; j + 16 <= length; j += 16)
+        acc = _mm512_add_ps(acc, _mm512_mul_ps(_mm512_loadu_ps(weights + j), _mm512_loadu_ps(magnitudes + j)));
+        
+    if (j < length)
+    {
+        __mmask16 mask = (__mmask16)((1u << (length - j)) - 1);
+        acc = _mm512_add_ps(acc, _mm512_mul_ps(_mm512_maskz_loadu_ps(mask, weights + j),
+                                               _mm512_maskz_loadu_ps(mask, magnitudes + j)));
+    }
+    
+    return _mm512_reduce_add_ps(acc);
+}
+
+TARGET_avx512 static float flux_avx512(const float* bark_bins, const float* prev_bark_bins)
+{
+    const __m512 half = _mm512_set1_ps(0.5f);
+    __m512 acc = _mm512_setzero_ps();
+    
+    for (int i = 0; i < NUM_BARKS; i += 16)
+    {
+        __mmask16 mask = NUM_BARKS - i >= 16 ? 0xffff : (__mmask16)((1u << (NUM_BARKS - i)) - 1);
+        __m512 v = _mm512_sub_ps(_mm512_abs_ps(_mm512_maskz_loadu_ps(mask, bark_bins + i)),
+                                 _mm512_abs_ps(_mm512_maskz_loadu_ps(mask, prev_bark_bins + i)));
+        acc = _mm512_add_ps(acc, _mm512_add_ps(v, _mm512_mul_ps(_mm512_abs_ps(v), half)));
+    }
+    
+    return _mm512_reduce_add_ps(acc);
+}
+
+TARGET_avx512 static void window_strided_avx512(float* out, const float* frame, const float* window, int stride, int size)
+{
+    const __m512i index = _mm512_mullo_epi32(_mm512_setr_epi32(0, 1, 2, 3, 4, 5, 6, 7, 8, 9, 10, 11, 12, 13, 14, 15),
+                                             _mm512_set1_epi32(stride));
+    int i = 0;
+    
+    for (; i + 16 <= size; i += 16, frame += 16 * stride)
+        _mm512_storeu_ps(out + i, _mm512_mul_ps(_mm512_i32gather_ps(index, frame, 4), _mm512_loadu_ps(window + i)));
+        
+    if (i < size)
+    {
+        __mmask16 mask = (__mmask16)((1u << (size - i)) - 1);
+        __m512 v = _mm512_mask_i32gather_ps(_mm512_setzero_ps(), mask, index, frame, 4);
+        _mm512_mask_storeu_ps(out + i, mask, _mm512_mul_ps(v, _mm512_maskz_loadu_ps(mask, window + i)));
+    }
+}
+
+TARGET_avx512 static inline int lanes_avx512(const t_bark_band* band, const float* magnitude, int channels, int first, float* sums)
+{
+    for (int c = first; c < channels; c += 16)
+    {
+        __mmask16 mask = channels - c >= 16 ? 0xffff : (__mmask16)((1u << (channels - c)) - 1);
+        const float* bin = magnitude + c;
+        __m512 acc = _mm512_setzero_ps();
+        
+        for (int j = 0; j < band->length; j++, bin += channels)
+            acc = _mm512_add_ps(acc, _mm512_mul_ps(_mm512_set1_ps(band->weights[j]), _mm512_maskz_loadu_ps(mask, bin)));
+            
+        _mm512_mask_storeu_ps(sums + c, mask, acc);
+    }
+    
+    return channels;
+}
+#endif
+
+#if defined(POD_CPU_NEON)
+#pragma mark NEON
+
+static inline float sum_neon(float32x4_t v)
+{
+    float lanes[4];
+    
+    vst1q_f32(lanes, v);
+    return (lanes[0] + lanes[1]) + (lanes[2] + lanes[3]);
+}
+
+static inline void multiply_neon(float* out, const float* frame, const float* window, int size)
+{
+    int i = 0;
+    
+    for (; i + 4 <= size; i += 4)
+        vst1q_f32(out + i, vmulq_f32(vld1q_f32(frame + i), vld1q_f32(window + i)));
+        
+    for (; i < size; i++)
+        out[i] = frame[i] * window[i];
+}
+
+static inline float dot_neon(const float* weights, const float* magnitudes, int length)
+{
+    float32x4_t acc = vdupq_n_f32(0.0f);
+    int j = 0;
+    
+    for (; j + 4 <= length; j += 4)
+        acc = vmlaq_f32(acc, vld1q_f32(weights + j), vld1q_f32(magnitudes + j));
+        
+    float sum = sum_neon(acc);
+    for (; j < length; j++)
+        sum += weights[j] * magnitudes[j];
+        
+    return sum;
+}
+
+static float flux_neon(const float* bark_bins, const float* prev_bark_bins)
+{
+    float32x4_t acc = vdupq_n_f32(0.0f);
+    
+    for (int i = 0; i < NUM_BARKS; i += 4)
+    {
+        float32x4_t v = vsubq_f32(vabsq_f32(vld1q_f32(bark_bins + i)), vabsq_f32(vld1q_f32(prev_bark_bins + i)));
+        acc = vaddq_f32(acc, vmlaq_n_f32(v, vabsq_f32(v), 0.5f));
+    }
+    
+    return sum_neon(acc);
+}
+
+static void window_strided_neon(float* out, const float* frame, const float* window, int stride, int size)
+{
+    int i = 0;
+    
+    for (; i + 4 <= size; i += 4, frame += 4 * stride)
+    {
+        float lanes[4] = { frame[0], frame[stride], frame[2 * stride], frame[3 * stride] };
+        vst1q_f32(out + i, vmulq_f32(vld1q_f32(lanes), vld1q_f32(window + i)));
+    }
+    
+    for (; i < size; i++, frame += stride)
+        out[i] = frame[0] * window[i];
+}
+
+static inline int lanes_neon(const t_bark_band* band, const float* magnitude, int channels, int first, float* sums)
+{
+    int c = first;
+    
+    for (; c + 4 <= channels; c += 4)
+    {
+        const float* bin = magnitude + c;
+        float32x4_t acc = vdupq_n_f32(0.0f);
+        
+        for (int j = 0; j < band->length; j++, bin += channels)
+            acc = vaddq_f32(acc, vmulq_n_f32(vld1q_f32(bin), band->weights[j]));
+            
+        vst1q_f32(sums + c, acc);
+    }
+    
+    if (c + 2 <= channels)
+    {
+        const float* bin = magnitude + c;
+        float32x2_t acc = vdup_n_f32(0.0f);
+        
+        for (int j = 0; j < band->length; j++, bin += channels)
+            acc = vadd_f32(acc, vmul_n_f32(vld1_f32(bin), band->weights[j]));
+            
+        vst1_f32(sums + c, acc);
+        c += 2;
+    }
+    
+    if (c < channels)
+    {
+        const float* bin = magnitude + c;
+        float acc = 0.0f;
+        
+        for (int j = 0; j < band->length; j++, bin += channels)
+            acc += band->weights[j] * bin[0];
+            
+        sums[c++] = acc;
+    }
+    
+    return c;
+}
+#endif
+
+#pragma mark Kernel Sets
+
+// One channel only: a window of any size, and the bands as one dot product each
+#define MONO_KERNELS(isa)                                                                               \
+TARGET_##isa static void window_##isa(float* out, const float* frame, const float* window, int stride, int size) \
+{                                                                                                       \
+    (void)stride;                                                                                       \
+    multiply_##isa(out, frame, window, size);                                                           \
+}                                                                                                       \
+                                                                                                        \
+TARGET_##isa static void bands_##isa(const t_bark_band* bands, const float* magnitudes, int channels, float* sums, float* bark_bins) \
+{                                                                                                       \
+    (void)channels;                                                                                     \
+    (void)sums;                                                                                         \
+    for (int i = 0; i < NUM_BARKS; i++)                                                                 \
+        bark_bins[i] = dot_##isa(bands[i].weights, magnitudes + bands[i].start, bands[i].length);       \
+}
+
+// Several channels: a strided window, and the bands summed for whole groups of channels in the vector lanes
+#define CHANNEL_KERNELS(isa)                                                                            \
+TARGET_##isa static void bands_interleaved_##isa(const t_bark_band* bands, const float* magnitudes, int channels, float* sums, float* bark_bins) \
+{                                                                                                       \
+    for (int i = 0; i < NUM_BARKS; i++)                                                                 \
+    {                                                                                                   \
+        const float* magnitude = magnitudes + bands[i].start * channels;                                \
+        int done = lanes_##isa(&bands[i], magnitude, channels, 0, sums);                                \
+                                                                                                        \
+        lanes_scalar(&bands[i], magnitude, channels, done, sums);                                       \
+        for (int c = 0; c < channels; c++)                                                              \
+            bark_bins[c * NUM_BARKS + i] = sums[c];                                                     \
+    }                                                                                                   \
+}
+
+#define ISA_KERNELS(isa) MONO_KERNELS(isa) CHANNEL_KERNELS(isa)
+
+ISA_KERNELS(scalar)
+#if defined(POD_CPU_X86)
+ISA_KERNELS(sse2)
+ISA_KERNELS(avx2)
+ISA_KERNELS(avx512)
+#endif
+#if defined(POD_CPU_NEON)
+ISA_KERNELS(neon)
+#endif
+
+// Sets a build has no variants for stay zeroed and are never picked, see pod_set_isa
+static const t_pod_kernels mono_kernels[POD_NUM_ISAS] = {
+    [POD_ISA_SCALAR] = { window_scalar, bands_scalar, flux_scalar },
+#if defined(POD_CPU_X86)
+    [POD_ISA_SSE2] = { window_sse2, bands_sse2, flux_sse2 },
+    [POD_ISA_AVX2] = { window_avx2, bands_avx2, flux_avx2 },
+    [POD_ISA_AVX512] = { window_avx512, bands_avx512, flux_avx512 },
+#endif
+#if defined(POD_CPU_NEON)
+    [POD_ISA_NEON] = { window_neon, bands_neon, flux_neon },
+#endif
+};
+
+static const t_pod_kernels channel_kernels[POD_NUM_ISAS] = {
+    [POD_ISA_SCALAR] = { window_strided_scalar, bands_interleaved_scalar, flux_scalar },
+#if defined(POD_CPU_X86)
+    [POD_ISA_SSE2] = { window_strided_sse2, bands_interleaved_sse2, flux_sse2 },
+    [POD_ISA_AVX2] = { window_strided_avx2, bands_interleaved_avx2, flux_avx2 },
+    [POD_ISA_AVX512] = { window_strided_avx512, bands_interleaved_avx512, flux_avx512 },
+#endif
+#if defined(POD_CPU_NEON)
+    [POD_ISA_NEON] = { window_strided_neon, bands_interleaved_neon, flux_neon },
+#endif
+};
+
+static const t_pod_kernels* select_kernels(t_pod_isa isa, int channels)
+{
+    return channels > 1 ? &channel_kernels[isa] : &mono_kernels[isa];
+}
+
+#pragma mark - Worker -
+
+static t_pod_worker workers[POD_MAX_WORKERS];   // the pool, started with the first detector that has a latency
+static int num_workers = 0;
+static int worker_users = 0;                    // detectors with a latency
+
+static void start_worker(t_pod* x, int latency)
+{
+    t_pod_worker* w;
+    
+    if (latency > POD_MAX_LATENCY)
+    {
+        pod_log(x, "Latency is limited to 16 hops.");
+        latency = POD_MAX_LATENCY;
+    }
+    
+    for (int i = 0; i <= latency; i++)
+    {
+        x->frames[i].signal = pod_fft_alloc(x->window_size * x->channels);
+        x->frames[i].bark_bins = pod_fft_alloc(NUM_BARKS * x->channels);
+        
+        if (x->frames[i].signal == NULL || x->frames[i].bark_bins == NULL)
+        {
+            pod_log(x, "Out of memory for worker frames. Analysing on the calling thread.");
+            return;
+        }
+    }
+    
+    x->worker_arena = make_scratch(&x->worker_scratch, x->window_size, x->channels);
+    if (x->worker_arena == NULL)
+    {
+        pod_log(x, "Out of memory for worker frames. Analysing on the calling thread.");
+        return;
+    }
+    
+    if (start_pool() != 0)
+    {
+        pod_log(x, "Could not create the worker thread. Analysing on the calling thread.");
+        return;
+    }
+    
+    x->frames_sent = x->frames_received = x->frames_claimed = 0;
+    x->worker_slot = -1;
+    x->worker_behind = 0;
+    x->latency = latency;
+    
+    // the thread with the fewest detectors takes this one
+    w = &workers[0];
+    for (int i = 1; i < num_workers; i++)
+        if (workers[i].count < w->count)
+            w = &workers[i];
+            
+    pthread_mutex_lock(&w->lock);
+    x->worker = w;
+    x->worker_next = w->detectors;
+    w->detectors = x;
+    w->count++;
+    pthread_mutex_unlock(&w->lock);
+    worker_users++;
+}
+
+static void stop_worker(t_pod* x)
+{
+    if (x->latency > 0)
+    {
+        t_pod_worker* w = x->worker;
+        
+        // with the lock held the thread is not partway through any frame of ours
+        pthread_mutex_lock(&w->lock);
+        for (t_pod** d = &w->detectors; *d != NULL; d = &(*d)->worker_next)
+        {
+            if (*d == x)
+            {
+                *d = x->worker_next;
+                break;
+            }
+        }
+        w->count--;
+        pthread_mutex_unlock(&w->lock);
+        
+        x->worker = NULL;
+        x->latency = 0;
+        if (--worker_users == 0)
+            stop_pool();
+    }
+    
+    for (int i = 0; i <= POD_MAX_LATENCY; i++)
+    {
+        pod_fft_free(x->frames[i].signal);
+        pod_fft_free(x->frames[i].bark_bins);
+    }
+    
+    pod_fft_free(x->worker_arena);
+    x->worker_arena = NULL;
+}
+
+// One thread per core but one, up to POD_MAX_WORKERS, started with the first detector that has a latency and
+// stopped with the last. Returns -1 if not even one could be started.
+static int start_pool(void)
+{
+    long cores = sysconf(_SC_NPROCESSORS_ONLN);
+    int wanted = cores - 1 < 1 ? 1 : cores - 1 > POD_MAX_WORKERS ? POD_MAX_WORKERS : (int)cores - 1;
+    
+    if (num_workers > 0)
+        return 0;
+        
+    while (num_workers < wanted)
+    {
+        t_pod_worker* w = &workers[num_workers];
+        
+        memset(w, 0, sizeof(t_pod_worker));
+        if (POD_SEM_INIT(&w->work_ready) != 0)
+            break;
+            
+        if (pthread_mutex_init(&w->lock, NULL) != 0)
+        {
+            POD_SEM_DESTROY(&w->work_ready);
+            break;
+        }
+        
+        if (pthread_create(&w->thread, NULL, worker_main, w) != 0)
+        {
+            pthread_mutex_destroy(&w->lock);
+            POD_SEM_DESTROY(&w->work_ready);
+            break;
+        }
+        
+        num_workers++;
+    }
+    
+    return num_workers > 0 ? 0 : -1;
+}
+
+static void stop_pool(void)
+{
+    for (int i = 0; i < num_workers; i++)
+    {
+        __atomic_store_n(&workers[i].stop, 1, __ATOMIC_RELEASE);
+        POD_SEM_POST(&workers[i].work_ready);
+        pthread_join(workers[i].thread, NULL);
+        
+        pthread_mutex_destroy(&workers[i].lock);
+        POD_SEM_DESTROY(&workers[i].work_ready);
+    }
+    
+    num_workers = 0;
+}
+
+static float* make_scratch(t_pod_scratch* scratch, int window_size, int channels)
+{
+    int offset = 0;
+    int analysis = arena_carve(&offset, window_size);
+    int spectrum = arena_carve(&offset, window_size + 2);
+    int fft_work = arena_carve(&offset, window_size);
+    int magnitudes = arena_carve(&offset, window_size / 2 * channels);
+    int band_sums = arena_carve(&offset, channels);
+    int bark_bins = arena_carve(&offset, NUM_BARKS * channels);
+    float* arena = pod_fft_alloc(offset);
+    
+    if (arena != NULL)
+    {
+        scratch->analysis = arena + analysis;
+        scratch->spectrum = arena + spectrum;
+        scratch->fft_work = arena + fft_work;
+        scratch->magnitudes = arena + magnitudes;
+        scratch->band_sums = arena + band_sums;
+        scratch->bark_bins = arena + bark_bins;
+    }
+    
+    return arena;
+}
+
+static void* worker_main(void* arg)
+{
+    t_pod_worker* w = (t_pod_worker *)arg;
+    
+    // There is a post for every frame sent, and the caller may have taken some of them itself, so a wakeup can
+    // find nothing to do but never misses a frame
+    for (;;)
+    {
+        POD_SEM_WAIT(&w->work_ready);
+        
+        if (__atomic_load_n(&w->stop, __ATOMIC_ACQUIRE))
+            break;
+            
+        pthread_mutex_lock(&w->lock);
+        for (t_pod** d = &w->detectors; *d != NULL; d = &(*d)->worker_next)
+        {
+            t_pod* x = *d;
+            
+            if (work_frame(x))
+            {
+                // to the back, so the others get a turn before this one's next frame
+                t_pod** tail = d;
+                
+                *d = x->worker_next;
+                while (*tail != NULL)
+                    tail = &(*tail)->worker_next;
+                *tail = x;
+                x->worker_next = NULL;
+                break;
+            }
+        }
+        pthread_mutex_unlock(&w->lock);
+    }
+    
+    return NULL;
+}
+
+// Takes the oldest frame nobody has taken and analyses it with the worker's own buffers. Returns 0 if there
+// was none. The slot is announced before the frame is taken, so the caller never reuses a slot still being read.
+static int work_frame(t_pod* x)
+{
+    long long k = __atomic_load_n(&x->frames_claimed, __ATOMIC_SEQ_CST);
+    
+    while (k < __atomic_load_n(&x->frames_sent, __ATOMIC_ACQUIRE))
+    {
+        int slot = __atomic_load_n(&x->slot_of[k % x->latency], __ATOMIC_RELAXED);
+        
+        __atomic_store_n(&x->worker_slot, slot, __ATOMIC_SEQ_CST);
+        
+        // fails if the caller took frame k first, leaving the next one in k
+        if (__atomic_compare_exchange_n(&x->frames_claimed, &k, k + 1, 0, __ATOMIC_SEQ_CST, __ATOMIC_SEQ_CST))
+        {
+            t_pod_frame* frame = &x->frames[slot];
+            
+            analyze_frame(x, &x->worker_scratch, frame->signal, frame->bark_bins, PROFILE_OF(frame));
+            __atomic_store_n(&frame->done, k + 1, __ATOMIC_RELEASE);
+            __atomic_store_n(&x->worker_slot, -1, __ATOMIC_RELEASE);
+            return 1;
+        }
+    }
+    
+    __atomic_store_n(&x->worker_slot, -1, __ATOMIC_RELEASE);
+    return 0;
+}
+
+// The window starting at oldest in the history, taken when sample_count was sample
+static void send_frame(t_pod* x, int oldest, long long sample)
+{
+    int slot = free_slot(x);
+    t_pod_frame* frame = &x->frames[slot];
+    int channels = x->channels;
+    
+    // the frame is contiguous in the history, see mirror_history
+    memcpy(frame->signal, x->signal + oldest * channels, x->window_size * channels * sizeof(float));
+    frame->sample = sample;
+#ifdef POD_PROFILE
+    memset(&frame->profile, 0, sizeof(t_pod_profile));
+#endif
+    
+    __atomic_store_n(&x->slot_of[x->frames_sent % x->latency], slot, __ATOMIC_RELAXED);
+    __atomic_store_n(&x->frames_sent, x->frames_sent + 1, __ATOMIC_RELEASE);
+    POD_SEM_POST(&x->worker->work_ready);
+}
+
+// A slot neither holding a frame still out nor being read by the worker. With fewer than latency frames out
+// and at most one more slot being read, one of the latency + 1 is always free.
+static int free_slot(const t_pod* x)
+{
+    int reading = __atomic_load_n(&x->worker_slot, __ATOMIC_SEQ_CST);
+    
+    for (int slot = 0; slot <= x->latency; slot++)
+    {
+        int used = slot == reading;
+        
+        for (long long k = x->frames_received; k < x->frames_sent && ! used; k++)
+            used = x->slot_of[k % x->latency] == slot;
+            
+        if (! used)
+            return slot;
+    }
+    
+    return -1;
+}
+
+static void drain_worker(t_pod* x)
+{
+    if (x->latency == 0)
+        return;
+        
+    // With the lock held the worker is partway through no frame of ours, and once every frame is taken it has
+    // nothing to start until the next one is sent. The ones it had not done are then analysed here, outside the
+    // lock, since picking them calls back into the host.
+    pthread_mutex_lock(&x->worker->lock);
+    __atomic_store_n(&x->frames_claimed, x->frames_sent, __ATOMIC_SEQ_CST);
+    pthread_mutex_unlock(&x->worker->lock);
+    
+    while (x->frames_received < x->frames_sent)
+        receive_frame(x);
+}
+
+// Picks the oldest frame out, and never waits for the worker: a frame it has not started is taken and analysed
+// here, and one it is partway through is analysed here as well, so what is reported and when stay the same
+// however far behind it falls. Returns 1 if the frame was not ready.
+static int receive_frame(t_pod* x)
+{
+    long long k = x->frames_received;
+    t_pod_frame* frame = &x->frames[x->slot_of[k % x->latency]];
+    
+    if (__atomic_load_n(&frame->done, __ATOMIC_ACQUIRE) == k + 1)
+    {
+#ifdef POD_PROFILE
+        for (int i = 0; i < POD_NUM_STAGES; i++)
+            x->profile.ns[i] += frame->profile.ns[i];
+#endif
+        
+        detect_onsets(x, frame->bark_bins, frame->sample);
+        x->frames_received++;
+        return 0;
+    }
+    else
+    {
+        long long expected = k;
+        
+        // leaves the frame to the worker only if it already has it, and then the worker's result goes unused
+        __atomic_compare_exchange_n(&x->frames_claimed, &expected, k + 1, 0, __ATOMIC_SEQ_CST, __ATOMIC_SEQ_CST);
+        analyze_frame(x, &x->scratch, frame->signal, x->bark_frame, PROFILE_OF(x));
+        detect_onsets(x, x->bark_frame, frame->sample);
+        x->frames_received++;
+        return 1;
+    }
+}
+
+
+#pragma mark - Peak Picking Helper Functions -
+
+static float accumulate_bin_differences(t_pod* x, t_pod_channel* c, int channel){
+    
+    float diff = x->kernels->flux(c->bark_bins, c->prev_bark_bins);
+    
+    if (x->config.flux)
+        x->config.flux(x->config.user, channel, x->frame_sample, diff);
+    
+    return diff;
+}
+
+static void iterate_bark_bins(t_pod_channel* c){
+    
+    int length = sizeof(c->bark_bins) / sizeof(float);
+    for (int i = 0; i < length; i++) {
+        c->prev_bark_bins[i] = c->bark_bins[i];
+    }
+    
+}
+
+static void reset_channel(t_pod* x, t_pod_channel* c)
+{
+    memset(c->bark_bins, 0, sizeof(c->bark_bins));
+    memset(c->prev_bark_bins, 0, sizeof(c->prev_bark_bins));
+    c->bark_difference = 0.0;
+    c->peak_value = 0.0;
+    c->peak_sample = 0;
+    c->flag = 0;
+    c->debounce_iterator = 0;
+    c->consecutive_onset_filtering_iterator = 0;
+    c->consecutive_onset_flag = 0;
+    c->maskIterator = 0;
+    c->maskFlag = 0;
+    pod_stats_clear(c->average);
+}
+
+
+#pragma mark - Scheduling -
+
+static float frame_cost(const t_pod* x)
+{
+    // An fft's worth of work per channel, or just the copy of the history when a worker does the fft
+    float size = x->window_size / 1024.0;
+    float ffts = size * log2(x->window_size);
+    
+    if (x->latency > 0)
+        return x->channels * size / 10.0;
+        
+    // the filters run every sample, so a frame only reads their envelopes
+    if (x->engine == POD_ENGINE_BANK)
+        return x->channels * NUM_BARKS / 10240.0;
+        
+    for (int i = 0; i < x->num_resolutions; i++)
+        ffts += x->resolutions[i].window_size / 1024.0 * log2(x->resolutions[i].window_size);
+        
+    return x->channels * ffts / 10.0;
+}
+
+static int schedule_classes(const t_pod* x)
+{
+    // Distinct blocks a frame can land on within one hop
+    return x->hop_size > POD_SCHEDULE_BLOCK ? x->hop_size / POD_SCHEDULE_BLOCK : 1;
+}
+
+static float* schedule_loads(const t_pod* skip, int* blocks)
+{
+    // Hops are powers of two, so the whole pattern repeats every largest hop
+    float* loads;
+    
+    for (const t_pod* d = detectors; d != NULL; d = d->next)
+        if (d != skip && schedule_classes(d) > *blocks)
+            *blocks = schedule_classes(d);
+    
+    loads = (float *)calloc(*blocks, sizeof(float));
+    if (loads == NULL)
+        return NULL;
+    
+    for (const t_pod* d = detectors; d != NULL; d = d->next)
+    {
+        if (d == skip)
+            continue;
+        
+        int classes = schedule_classes(d);
+        float cost = frame_cost(d);
+        
+        for (int b = (d->phase / POD_SCHEDULE_BLOCK) % classes; b < *blocks; b += classes)
+            loads[b] += cost;
+    }
+    
+    return loads;
+}
+
+static int schedule_phase(t_pod* x)
+{
+    int classes = schedule_classes(x);
+    int blocks = classes;
+    int best = 0;
+    float best_peak = 0.0, best_total = 0.0;
+    float* loads = schedule_loads(x, &blocks);
+    
+    if (loads == NULL)
+        return 0;
+    
+    // Take the blocks whose busiest one is lightest, then the lightest overall, then the earliest
+    for (int c = 0; c < classes; c++)
+    {
+        float peak = 0.0, total = 0.0;
+        
+        for (int b = c; b < blocks; b += classes)
+        {
+            if (loads[b] > peak)
+                peak = loads[b];
+            total += loads[b];
+        }
+        
+        if (c == 0 || peak < best_peak || (peak == best_peak && total < best_total))
+        {
+            best = c;
+            best_peak = peak;
+            best_total = total;
+        }
+    }
+    
+    free(loads);
+    return best * POD_SCHEDULE_BLOCK;
+}
+
+int pod_get_phase(const t_pod* x)
+{
+    return x->phase;
+}
+
+int pod_set_phase(t_pod* x, int phase)
+{
+    x->phase_automatic = phase < 0;
+    x->phase = x->phase_automatic ? schedule_phase(x) : phase % x->hop_size;
+    
+    // the next frame comes when sample_count + phase reaches a multiple of the hop
+    x->dsp_tick = (x->sample_count + x->phase) % x->hop_size;
+    return 0;
+}
+
+void pod_get_schedule(t_pod_schedule* schedule)
+{
+    int blocks = 1;
+    float* loads = schedule_loads(NULL, &blocks);
+    
+    memset(schedule, 0, sizeof(t_pod_schedule));
+    
+    for (const t_pod* d = detectors; d != NULL; d = d->next)
+        schedule->detectors++;
+    
+    if (loads == NULL)
+        return;
+    
+    schedule->blocks = blocks;
+    for (int b = 0; b < blocks; b++)
+    {
+        if (loads[b] > schedule->peak)
+            schedule->peak = loads[b];
+        schedule->mean += loads[b] / blocks;
+    }
+    
+    free(loads);
+}
+
+#pragma mark - Utilities -
+
+static int isPowerOfTwo(unsigned int x)
+{
+    //Complement and Compare
+    return ((x != 0) && ((x & (~x + 1)) == x));
+}
+
+static float halfwave_rectify(float value)
+{
+    return (value + fabs(value) / 2);
+}
+
+static int consecutive_frames(t_pod* x, float ms)
+{
+    return floor(ms/(((x->hop_size)*1000)/x->sample_rate));
+}
+
+static int average_frames(t_pod* x, float ms)
+{
+    // analysis frames in ms, at least one; none for the whole session
+    if (ms <= 0.0)
+        return 0;
+    
+    int frames = ceil(ms * x->sample_rate / (1000.0 * x->hop_size));
+    return frames > 0 ? frames : 1;
+}
+
+static void pod_log(t_pod* x, const char* message)
+{
+    // Messages are string literals so nothing is formatted or copied on the audio thread
+    if (x->config.log)
+        x->config.log(x->config.user, message);
+}
+
+#ifdef POD_PROFILE
+static double profile_now(void)
+{
+#ifdef __APPLE__
+    static mach_timebase_info_data_t timebase;
+    
+    if (timebase.denom == 0)
+        mach_timebase_info(&timebase);
+    
+    return (double)mach_absolute_time() * timebase.numer / timebase.denom;
+#else
+    struct timespec now;
+    
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    return now.tv_sec * 1e9 + now.tv_nsec;
+#endif
+}
+#endif
+
+#pragma mark - Memory Management -
+
+void pod_destroy(t_pod* x)
+{
+    if (x == NULL)
+        return;
+    
+    for (t_pod** d = &detectors; *d != NULL; d = &(*d)->next)
+    {
+        if (*d == x)
+        {
+            *d = x->next;
+            break;
+        }
+    }
+    
+    stop_worker(x);
+    
+    pod_fft_free(x->arena);
+    pod_fft_plan_release(x->fft_plan);
+    pod_sdft_destroy(x->sdft);
+    pod_bank_destroy(x->bank);
+    
+    tables_release(x->tables);
+    for (int i = 0; i < x->num_resolutions; i++)
+        free_resolution(&x->resolutions[i]);
+    for (int i = 0; x->channel != NULL && i < x->channels; i++)
+        pod_stats_destroy(x->channel[i].average);
+    free(x->channel);
+    free(x);
+}
+
+void pod_reset(t_pod* x)
+{
+    // Drop every frame still out. Whatever the worker is partway through it finishes unseen, and its slot
+    // stays out of use until then, see free_slot.
+    __atomic_store_n(&x->frames_claimed, x->frames_sent, __ATOMIC_SEQ_CST);
+    x->frames_received = x->frames_sent;
+    
+    pod_sos_reset(&x->ear_filter);
+    memset(x->filter_state, 0, pod_sos_channel_state_size(&x->ear_filter, x->channels) * sizeof(float));
+    memset(x->signal, 0, (x->history_size + x->window_size) * x->channels * sizeof(float));
+    x->write_index = 0;
+    x->slice_stage = SLICE_IDLE;
+    x->dsp_tick = x->phase;
+    x->sample_count = 0;
+    
+    for (int i = 0; i < x->channels; i++)
+        reset_channel(x, &x->channel[i]);
+    
+    if (x->engine == POD_ENGINE_SDFT)
+        load_sdft(x);
+    else if (x->engine == POD_ENGINE_BANK)
+        pod_bank_reset(x->bank);
+}
+
+#pragma mark - Profiling -
+
+int pod_get_profile(const t_pod* x, t_pod_profile* profile)
+{
+#ifdef POD_PROFILE
+    *profile = x->profile;
+    return 0;
+#else
+    memset(profile, 0, sizeof(t_pod_profile));
+    return -1;
+#endif
+}
+
+void pod_reset_profile(t_pod* x)
+{
+#ifdef POD_PROFILE
+    memset(&x->profile, 0, sizeof(t_pod_profile));
+#endif
+}
+
+const char* pod_stage_name(t_pod_stage stage)
+{
+    if (stage < 0 || stage >= POD_NUM_STAGES)
+        return "unknown";
+    
+    return stage_names[stage];
+}
+
+#pragma mark - Parameters -
+
+int pod_get_window_size(const t_pod* x)
+{
+    return x->window_size;
+}
+
+int pod_get_hop_size(const t_pod* x)
+{
+    return x->hop_size;
+}
+
+int pod_get_channels(const t_pod* x)
+{
+    return x->channels;
+}
+
+float pod_get_sample_rate(const t_pod* x)
+{
+    return x->sample_rate;
+}
+
+int pod_get_latency(const t_pod* x)
+{
+    return x->latency;
+}
+
+int pod_get_spread(const t_pod* x)
+{
+    int windows = (x->window_size + SLICE_SIZE - 1) / SLICE_SIZE;
+    int magnitudes = (x->tables->bins + SLICE_SIZE - 1) / SLICE_SIZE;
+    
+    if (! x->spread)
+        return 0;
+    
+    // every channel's window slices, its fft and its magnitude slices, then the bands of all of them
+    return x->channels * (windows + 1 + magnitudes) + 1;
+}
+
+int pod_set_window_size(t_pod* x, int size)
+{
+    if (size <= 0 || ! isPowerOfTwo(size))
+        return -1;
+        
+    if (size == x->window_size)
+        return 0;
+        
+    return resize_analysis(x, size, x->hop_size);
+}
+
+int pod_set_hop_size(t_pod* x, int size)
+{
+    if (size <= 0 || ! isPowerOfTwo(size))
+        return -1;
+        
+    if (size == x->hop_size)
+        return 0;
+        
+    return resize_analysis(x, x->window_size, size);
+}
+
+int pod_set_window_type(t_pod* x, int type)
+{
+    t_pod_tables* tables;
+    
+    if (type < 0 || type > 1)
+        return -1;
+        
+    if (type == x->tables->window_type)
+        return 0;
+        
+    tables = tables_acquire(type, x->window_size, x->sample_rate);
+    if (tables == NULL)
+        return -1;
+        
+    use_tables(x, tables, NULL);
+    return 0;
+}
+
+int pod_set_sample_rate(t_pod* x, float sample_rate)
+{
+    t_pod_tables* tables;
+    t_pod_sdft* sdft = NULL;
+    t_pod_bank* bank = NULL;
+    
+    if (sample_rate <= 0.0)
+        return -1;
+        
+    if (sample_rate == x->sample_rate)
+        return 0;
+        
+    tables = tables_acquire(x->tables->window_type, x->window_size, sample_rate);
+    if (tables == NULL)
+        return -1;
+        
+    if (x->engine == POD_ENGINE_SDFT)
+        sdft = create_sdft(x, tables);
+    else if (x->engine == POD_ENGINE_BANK)
+        bank = create_bank(x, sample_rate);
+        
+    if ((x->engine == POD_ENGINE_SDFT && sdft == NULL) || (x->engine == POD_ENGINE_BANK && bank == NULL))
+    {
+        pod_sdft_destroy(sdft);
+        pod_bank_destroy(bank);
+        tables_release(tables);
+        return -1;
+    }
+    
+    use_tables(x, tables, sdft);
+    
+    // the filters start again from silence, tuned to the new rate
+    if (bank != NULL)
+    {
+        pod_bank_destroy(x->bank);
+        x->bank = bank;
+    }
+    
+    x->sample_rate = sample_rate;
+    x->consecutive_onset_filtering_threshold = consecutive_frames(x, x->consecutive_ms);
+    if (x->average_ms > 0.0)
+        pod_set_average_window(x, x->average_ms);
+        
+    return 0;
+}
+
+int pod_set_spread(t_pod* x, int spread)
+{
+    if (spread && (x->latency > 0 || x->engine != POD_ENGINE_FFT || x->num_resolutions > 0))
+        return -1;
+    
+    if (! spread)
+        finish_frame(x);
+    
+    x->spread = spread != 0;
+    return 0;
+}
+
+int pod_set_power(t_pod* x, int power)
+{
+    // the worker may be reading it
+    finish_frame(x);
+    drain_worker(x);
+    
+    x->power = power != 0;
+    return 0;
+}
+
+int pod_set_engine(t_pod* x, int engine)
+{
+    t_pod_bank* bank = NULL;
+    t_pod_sdft* sdft = NULL;
+    
+    if (engine != POD_ENGINE_FFT && engine != POD_ENGINE_SDFT && engine != POD_ENGINE_BANK)
+        return -1;
+        
+    if (engine != POD_ENGINE_FFT && (x->latency > 0 || x->spread || x->num_resolutions > 0))
+        return -1;
+        
+    if (engine == POD_ENGINE_BANK && x->engine != POD_ENGINE_BANK)
+    {
+        bank = create_bank(x, x->sample_rate);
+        if (bank == NULL)
+            return -1;
+            
+        // run the filters over the history as it stands, so the envelopes are already settled
+        pod_bank_update(bank, x->signal, x->history_size, x->write_index, x->history_size);
+    }
+    
+    if (engine == POD_ENGINE_SDFT && x->engine != POD_ENGINE_SDFT)
+    {
+        sdft = create_sdft(x, x->tables);
+        if (sdft == NULL)
+            return -1;
+    }
+    
+    // the filters and the sliding bins are only kept while they run
+    if (engine != POD_ENGINE_BANK)
+    {
+        pod_bank_destroy(x->bank);
+        x->bank = NULL;
+    }
+    else if (bank != NULL)
+        x->bank = bank;
+        
+    if (engine != POD_ENGINE_SDFT)
+    {
+        pod_sdft_destroy(x->sdft);
+        x->sdft = NULL;
+    }
+    else if (sdft != NULL)
+        x->sdft = sdft;
+        
+    // pick up from the history as it stands
+    if (engine == POD_ENGINE_SDFT)
+        load_sdft(x);
+        
+
+    x->engine = engine;
+    return 0;
+}
+
+int pod_set_resolutions(t_pod* x, const int* sizes, int count)
+{
+    t_pod_resolution made[POD_MAX_RESOLUTIONS - 1];
+    int sorted[POD_MAX_RESOLUTIONS - 1];
+    
+    if (count < 0 || count > POD_MAX_RESOLUTIONS - 1)
+        return -1;
+        
+    if (count > 0 && (x->spread || x->engine != POD_ENGINE_FFT))
+        return -1;
+        
+    // longest first, each a power of two shorter than the one before
+    for (int i = 0; i < count; i++)
+    {
+        int j = i;
+        
+        for (; j > 0 && sorted[j - 1] < sizes[i]; j--)
+            sorted[j] = sorted[j - 1];
+        sorted[j] = sizes[i];
+    }
+    
+    for (int i = 0; i < count; i++)
+        if (! isPowerOfTwo(sorted[i]) || sorted[i] < MIN_RESOLUTION || sorted[i] >= (i ? sorted[i - 1] : x->window_size))
+            return -1;
+            
+    for (int i = 0; i < count; i++)
+    {
+        if (make_resolution(x, &made[i], sorted[i]) != 0)
+        {
+            while (i-- > 0)
+                free_resolution(&made[i]);
+            return -1;
+        }
+    }
+    
+    // nothing may still be reading the old ones
+    finish_frame(x);
+    drain_worker(x);
+    
+    for (int i = 0; i < x->num_resolutions; i++)
+        free_resolution(&x->resolutions[i]);
+        
+    memcpy(x->resolutions, made, count * sizeof(t_pod_resolution));
+    x->num_resolutions = count;
+    assign_bands(x);
+    
+    return 0;
+}
+
+int pod_get_resolutions(const t_pod* x, int* sizes, int* first_bands)
+{
+    sizes[0] = x->window_size;
+    first_bands[0] = 0;
+    
+    for (int i = 0; i < x->num_resolutions; i++)
+    {
+        sizes[i + 1] = x->resolutions[i].window_size;
+        first_bands[i + 1] = x->resolutions[i].first_band;
+    }
+    
+    return x->num_resolutions + 1;
+}
+
+float pod_check_engine(t_pod* x)
+{
+    float a0, a1;
+    float worst = 0.0, largest = 0.0;
+    int oldest = (x->write_index - x->window_size) & (x->history_size - 1);
+    
+    if (x->engine != POD_ENGINE_SDFT)
+        return -1.0;
+    
+    // The fft path with the same periodic window the sliding bins are convolved with, bin by bin over
+    // everything the filterbank reads
+    raised_cosine(x->tables->window_type, &a0, &a1);
+    for (int channel = 0; channel < x->channels; channel++)
+    {
+        pod_sdft_magnitudes(x->sdft, channel, a0, a1, x->scratch.magnitudes + channel, x->channels, 0);
+        
+        for (int i = 0; i < x->window_size; i++)
+            x->scratch.analysis[i] = x->signal[((oldest + i) & (x->history_size - 1)) * x->channels + channel] *
+                             (a0 - 2.0 * a1 * cos((TWO_PI * i) / x->window_size)) / x->window_size;
+        
+        pod_fft_forward(x->fft_plan, x->scratch.analysis, x->scratch.spectrum, x->scratch.fft_work);
+        
+        for (int i = 1; i < x->tables->bands[NUM_BARKS - 1].start + x->tables->bands[NUM_BARKS - 1].length; i++)
+        {
+            float re = x->scratch.spectrum[2 * i];
+            float im = x->scratch.spectrum[2 * i + 1];
+            float reference = sqrtf((re * re) + (im * im));
+            float error = fabs(reference - x->scratch.magnitudes[i * x->channels + channel]);
+            
+            if (error > worst)
+                worst = error;
+            if (reference > largest)
+                largest = reference;
+        }
+    }
+    
+    return largest > 0.0 ? worst / largest : 0.0;
+}
+
+static float check_noise(unsigned int* seed)
+{
+    *seed = *seed * 1664525u + 1013904223u;
+    return (float)(*seed >> 8) / (float)(1 << 23) - 1.0;
+}
+
+static float check_error(const float* actual, const float* expected, int n, float* largest)
+{
+    float worst = 0.0;
+    
+    for (int i = 0; i < n; i++)
+    {
+        if (fabs(actual[i] - expected[i]) > worst)
+            worst = fabs(actual[i] - expected[i]);
+        if (fabs(expected[i]) > *largest)
+            *largest = fabs(expected[i]);
+    }
+    
+    return worst;
+}
+
+float pod_check_isa(t_pod* x, t_pod_isa isa)
+{
+    const t_pod_kernels* kernels;
+    const t_pod_kernels* reference;
+    t_pod_sos filter = x->ear_filter;
+    t_pod_sos reference_filter = x->ear_filter;
+    int n = x->window_size;
+    int length = n - 3;                         // leaves every kernel a tail
+    float worst = 0.0, largest, error;
+    float bark_bins[2][NUM_BARKS], prev_bark_bins[NUM_BARKS], sum, sums[CHECK_CHANNELS];
+    unsigned int seed = 1;
+    
+    if (! pod_cpu_supports(isa))
+        return -1.0;
+        
+    kernels = select_kernels(isa, 1);
+    reference = select_kernels(POD_ISA_SCALAR, 1);
+    
+    float* input = pod_fft_alloc(CHECK_CHANNELS * n);
+    float* actual = pod_fft_alloc(CHECK_CHANNELS * n);
+    float* expected = pod_fft_alloc(CHECK_CHANNELS * n);
+    float* state = pod_fft_alloc(2 * pod_sos_channel_state_size(&filter, CHECK_CHANNELS));
+    t_pod_bank* bank = pod_bank_create(bark_lim, bark_ctr + 1, x->sample_rate, CHECK_CHANNELS);
+    t_pod_bank* reference_bank = pod_bank_create(bark_lim, bark_ctr + 1, x->sample_rate, CHECK_CHANNELS);
+    const float* inputs[CHECK_CHANNELS];
+    
+    if (input == NULL || actual == NULL || expected == NULL || state == NULL || bank == NULL || reference_bank == NULL)
+    {
+        pod_fft_free(input);
+        pod_fft_free(actual);
+        pod_fft_free(expected);
+        pod_fft_free(state);
+        pod_bank_destroy(bank);
+        pod_bank_destroy(reference_bank);
+        return -1.0;
+    }
+    
+    for (int i = 0; i < CHECK_CHANNELS * n; i++)
+        input[i] = check_noise(&seed);
+    for (int c = 0; c < CHECK_CHANNELS; c++)
+        inputs[c] = input + c * n;
+        
+    // Ear filter, one channel and then enough at once for every lane grouping to run
+    pod_sos_reset(&filter);
+    pod_sos_reset(&reference_filter);
+    pod_sos_process_isa(&filter, input, actual, length, isa);
+    pod_sos_process_scalar(&reference_filter, input, expected, length);
+    largest = 0.0;
+    error = check_error(actual, expected, length, &largest);
+    worst = fmax(worst, largest > 0.0 ? error / largest : 0.0);
+    
+    pod_sos_process_channels_isa(&filter, state, CHECK_CHANNELS, inputs, 0, actual, length, isa);
+    pod_sos_process_channels_isa(&filter, state + pod_sos_channel_state_size(&filter, CHECK_CHANNELS), CHECK_CHANNELS,
+                                 inputs, 0, expected, length, POD_ISA_SCALAR);
+    largest = 0.0;
+    error = check_error(actual, expected, CHECK_CHANNELS * length, &largest);
+    worst = fmax(worst, largest > 0.0 ? error / largest : 0.0);
+    
+    // Window, over the detector's own window
+    kernels->window(actual, input, x->tables->window, 1, n);
+    reference->window(expected, input, x->tables->window, 1, n);
+    largest = 0.0;
+    error = check_error(actual, expected, n, &largest);
+    worst = fmax(worst, largest > 0.0 ? error / largest : 0.0);
+    
+    // Magnitudes of a made-up spectrum, in both modes, up to the bins the filterbank reads
+    for (int power = 0; power < 2; power++)
+    {
+        pod_fft_magnitudes_isa(input, actual, 1, 0, x->tables->bins, power, isa);
+        pod_fft_magnitudes_isa(input, expected, 1, 0, x->tables->bins, power, POD_ISA_SCALAR);
+        largest = 0.0;
+        error = check_error(actual, expected, x->tables->bins, &largest);
+        worst = fmax(worst, largest > 0.0 ? error / largest : 0.0);
+    }
+    
+    // Bark bands from those magnitudes, then the flux from one set of bands to a made-up previous one
+    kernels->bands(x->tables->bands, expected, 1, &sum, bark_bins[0]);
+    reference->bands(x->tables->bands, expected, 1, &sum, bark_bins[1]);
+    largest = 0.0;
+    error = check_error(bark_bins[0], bark_bins[1], NUM_BARKS, &largest);
+    worst = fmax(worst, largest > 0.0 ? error / largest : 0.0);
+    
+    for (int i = 0; i < NUM_BARKS; i++)
+        prev_bark_bins[i] = bark_bins[1][i] * (1.0 + 0.5 * check_noise(&seed));
+        
+    sum = kernels->flux(bark_bins[1], prev_bark_bins);
+    error = reference->flux(bark_bins[1], prev_bark_bins);
+    largest = 0.0;
+    for (int i = 0; i < NUM_BARKS; i++)
+        largest += fabs(bark_bins[1][i]) + fabs(prev_bark_bins[i]);
+    worst = fmax(worst, largest > 0.0 ? fabs(sum - error) / largest : 0.0);
+    
+    // Window and Bark bands again through the several-channel set, on the noise taken as interleaved channels
+    kernels = select_kernels(isa, CHECK_CHANNELS);
+    reference = select_kernels(POD_ISA_SCALAR, CHECK_CHANNELS);
+    for (int c = 0; c < CHECK_CHANNELS; c++)
+    {
+        kernels->window(actual + c * length, input + c, x->tables->window, CHECK_CHANNELS, length);
+        reference->window(expected + c * length, input + c, x->tables->window, CHECK_CHANNELS, length);
+    }
+    largest = 0.0;
+    error = check_error(actual, expected, CHECK_CHANNELS * length, &largest);
+    worst = fmax(worst, largest > 0.0 ? error / largest : 0.0);
+    
+    kernels->bands(x->tables->bands, input, CHECK_CHANNELS, sums, actual);
+    reference->bands(x->tables->bands, input, CHECK_CHANNELS, sums, expected);
+    largest = 0.0;
+    error = check_error(actual, expected, CHECK_CHANNELS * NUM_BARKS, &largest);
+    worst = fmax(worst, largest > 0.0 ? error / largest : 0.0);
+    
+    // The filterbank engine over the same noise taken as interleaved channels, starting part way in so it wraps
+    pod_bank_update_isa(bank, input, n, n / 2, length, isa);
+    pod_bank_update_isa(reference_bank, input, n, n / 2, length, POD_ISA_SCALAR);
+    for (int power = 0; power < 2; power++)
+    {
+        for (int c = 0; c < CHECK_CHANNELS; c++)
+        {
+            pod_bank_envelopes(bank, c, actual + c * NUM_BARKS, power);
+            pod_bank_envelopes(reference_bank, c, expected + c * NUM_BARKS, power);
+        }
+        largest = 0.0;
+        error = check_error(actual, expected, CHECK_CHANNELS * NUM_BARKS, &largest);
+        worst = fmax(worst, largest > 0.0 ? error / largest : 0.0);
+    }
+    
+    pod_fft_free(input);
+    pod_fft_free(actual);
+    pod_fft_free(expected);
+    pod_fft_free(state);
+    pod_bank_destroy(bank);
+    pod_bank_destroy(reference_bank);
+    
+    return worst;
+}
+
+int pod_set_debounce_threshold(t_pod* x, int frames)
+{
+    // need to add error checking
+    x->debounce_threshold = frames;
+    return 0;
+}
+
+int pod_set_upper_threshold(t_pod* x, float threshold)
+{
+    // need to add error checking
+    for (int i = 0; i < x->channels; i++)
+        x->channel[i].u_threshold = threshold;
+    x->automaticThresholding = 0;
+    return 0;
+}
+
+int pod_set_lower_threshold(t_pod* x, float threshold)
+{
+    // need to add error checking
+    for (int i = 0; i < x->channels; i++)
+        x->channel[i].l_threshold = threshold;
+    x->automaticThresholding = 0;
+    return 0;
+}
+
+int pod_set_consecutive_threshold(t_pod* x, float ms)
+{
+    // need to add error checking
+    x->consecutive_ms = ms;
+    x->consecutive_onset_filtering_threshold = consecutive_frames(x, ms);
+    return 0;
+}
+
+int pod_set_upper_threshold_scale(t_pod* x, float scale)
+{
+    x->upper_threshold_scale = scale;
+    x->automaticThresholding = 1;
+    return 0;
+}
+
+int pod_set_lower_threshold_scale(t_pod* x, float scale)
+{
+    x->lower_threshold_scale = scale;
+    x->automaticThresholding = 1;
+    return 0;
+}
+
+void pod_reset_average(t_pod* x)
+{
+    for (int i = 0; i < x->channels; i++)
+        pod_stats_clear(x->channel[i].average);
+}
+
+int pod_set_average_window(t_pod* x, float ms)
+{
+    int frames = average_frames(x, ms);
+    t_pod_stats** averages = (t_pod_stats **)calloc(x->channels, sizeof(t_pod_stats*));
+    int failed = averages == NULL;
+    
+    // all or nothing: every channel's new window is made before any old one goes, so a failed allocation
+    // leaves them all in place
+    for (int i = 0; ! failed && i < x->channels; i++)
+    {
+        averages[i] = pod_stats_create(frames, x->percentile);
+        failed = averages[i] == NULL;
+    }
+    
+    if (failed)
+    {
+        for (int i = 0; averages != NULL && i < x->channels; i++)
+            pod_stats_destroy(averages[i]);
+        free(averages);
+        return -1;
+    }
+    
+    for (int i = 0; i < x->channels; i++)
+    {
+        pod_stats_destroy(x->channel[i].average);
+        x->channel[i].average = averages[i];
+    }
+    free(averages);
+    
+    x->average_ms = ms > 0.0 ? ms : 0.0;
+    return 0;
+}
+
+int pod_set_average_percentile(t_pod* x, float percentile)
+{
+    if (percentile > 100.0)
+        return -1;
+    
+    x->percentile = percentile < 0.0 ? -1.0 : percentile;
+    
+    for (int i = 0; i < x->channels; i++)
+        pod_stats_set_percentile(x->channel[i].average, x->percentile);
+    return 0;
+}
+
+int pod_get_average(const t_pod* x, int channel, t_pod_average* average)
+{
+    const t_pod_stats* stats;
+    
+    if (channel < 0 || channel >= x->channels)
+        return -1;
+    
+    stats = x->channel[channel].average;
+    average->frames = pod_stats_count(stats);
+    average->mean = pod_stats_mean(stats);
+    average->deviation = sqrt(pod_stats_variance(stats));
+    average->percentile = pod_stats_percentile(stats);
+    return 0;
+}
+
@@ -0,0 +1,266 @@
+//
+//  libpod.h
+//  pod
+//
+//
+// Copyright (C) 2012 Scott McCoid, Gregoire Tronel, Jay Clark
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy of this software
+// and associated documentation files (the "Software"), to deal in the Software without restriction,
+// including without limitation the rights to use, copy, modify, merge, publish, distribute, sublicense,
+// and/or sell copies of the Software, and to permit persons to whom the Software is furnished to do so,
+// subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in all copies or substantial
+// portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR IMPLIED, INCLUDING BUT NOT
+// LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.
+// IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY,
+// WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE
+// SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+
+
+// libpod is the pod~ onset detector without Pure Data: outer and middle ear filters, windowing, fft, Bark
+// band condensation, spectral flux and peak picking. The host owns the audio buffers and passes them to
+// pod_process_block; results come back through the callbacks in t_pod_config, on the calling thread.
+// Every event carries the number of input samples processed when it happened, so a host can log a whole
+// file's events and compare runs without Pd.
+
+#ifndef LIBPOD_H
+#define LIBPOD_H
+
+#include "pod_cpu.h"
+
+#define POD_NUM_BARKS 24
+#define POD_MAX_LATENCY 16                      // hops a frame may spend with the worker threads
+#define POD_SCHEDULE_BLOCK 64                   // host block size the phase scheduler plans for
+#define POD_MAX_RESOLUTIONS 3                   // the window and up to two shorter ones, see pod_set_resolutions
+
+typedef struct _pod t_pod;
+
+// An onset is confirmed some frames after its peak, once the debounce window or the lower threshold says
+// the peak is over. sample - peak_sample is that decision latency; the peak frame's window covers
+// peak_sample - window_size .. peak_sample, so a transient at its centre shows up as peak_sample - window_size / 2.
+typedef struct _pod_onset
+{
+    int         channel;                        // which input the onset was found in
+    long long   sample;                         // samples processed when the onset was reported
+    long long   peak_sample;                    // samples processed at the end of the frame holding the peak
+    float       peak;                           // spectral flux at the onset's peak
+    
+} t_pod_onset;
+
+// Pipeline stages timed when libpod is built with -DPOD_PROFILE
+typedef enum _pod_stage
+{
+    POD_STAGE_EAR_FILTER,                       // per sample, including the write into the signal history
+    POD_STAGE_WINDOW,                           // per frame from here on
+    POD_STAGE_FFT,
+    POD_STAGE_MAGNITUDE,
+    POD_STAGE_BARK,
+    POD_STAGE_LOUDNESS,
+    POD_STAGE_FLUX,
+    POD_STAGE_PEAK_PICKING,
+    POD_NUM_STAGES
+    
+} t_pod_stage;
+
+typedef struct _pod_profile
+{
+    double      ns[POD_NUM_STAGES];             // total time spent in each stage
+    long long   samples;                        // samples that went through the ear filter
+    long long   frames;                         // analysis frames run
+    
+} t_pod_profile;
+
+// Every detector in the process, as the phase scheduler sees it. Costs are in units of one 1024 point,
+// single channel analysis frame; a block is POD_SCHEDULE_BLOCK samples.
+typedef struct _pod_schedule
+{
+    int         detectors;
+    int         blocks;                         // length of the repeating pattern of frames
+    float       peak;                           // the most frame work that lands in any one block
+    float       mean;                           // frame work per block on average
+    
+} t_pod_schedule;
+
+// Where each frame's spectrum comes from
+typedef enum _pod_engine
+{
+    POD_ENGINE_FFT,                             // a real fft of the windowed history every hop
+    POD_ENGINE_SDFT,                            // a sliding dft of just the filterbank's bins, every sample
+    POD_ENGINE_BANK,                            // band-pass filters on the signal, read every hop
+    
+} t_pod_engine;
+
+// The flux history behind one channel's automatic thresholds
+typedef struct _pod_average
+{
+    int         frames;                         // frames in the history
+    float       mean;
+    float       deviation;                      // standard deviation
+    float       percentile;                     // the mean when the history is the whole session
+    
+} t_pod_average;
+
+typedef void (*t_pod_onset_fn)(void* user, const t_pod_onset* onset);
+typedef void (*t_pod_flux_fn)(void* user, int channel, long long sample, float flux);
+typedef void (*t_pod_log_fn)(void* user, const char* message);
+
+typedef struct _pod_config
+{
+    int             window_size;                // power of two, 1024 if not
+    int             hop_size;                   // power of two in samples, 256 if not
+    int             channels;                   // independent inputs analysed side by side, at least 1
+    float           sample_rate;                // Hz, 44100 if not given
+    int             latency;                    // hops, 0 to analyse every frame inside pod_process_block
+    int             spread;                     // 1 to spread each frame's work over the blocks of the next hop
+    int             engine;                     // t_pod_engine, POD_ENGINE_FFT if not
+    int             phase;                      // samples into the hop of the first frame, -1 to let the scheduler pick
+    int             power;                      // 1 to sum bin power into the Bark bands, 0 for magnitudes
+    float           average_ms;                 // flux history the automatic thresholds follow, 0 for all of it
+    float           percentile;                 // follow this percentile of that history, -1 for its mean
+    int             resolutions[POD_MAX_RESOLUTIONS - 1];   // shorter windows run alongside, 0 for none
+    
+    t_pod_onset_fn  onset;                      // every confirmed onset
+    t_pod_flux_fn   flux;                       // the spectral flux of every analysis frame
+    t_pod_log_fn    log;                        // diagnostics, as static strings; may come from pod_process_block
+    void*           user;                       // passed back to every callback
+    
+} t_pod_config;
+
+// With a latency of L hops the window, fft and Bark bands of each frame are computed on a worker thread
+// while the caller carries on. The frame's flux and peak picking run L hops later inside pod_process_block,
+// so callbacks still come on the calling thread and every event keeps the sample stamp it would have had
+// without the worker: the output is identical, only delivered L hops late. The detectors share a few
+// worker threads, one less than the cores and at most 4. pod_process_block never waits for them: a frame
+// the workers have not finished by then is analysed on the calling thread instead, with the same result,
+// and the log says so once each time the workers fall behind.
+
+// Without a worker, a whole frame's analysis normally runs in the block that completes its hop. Spreading
+// instead runs it in slices of at most 1024 samples or bins, one per block, starting the block after it
+// falls due: the windowing of each channel, its fft, its magnitudes, and finally the Bark bands, flux and
+// peak picking together. The events are the same, only the number of blocks pod_get_spread reports late.
+// If a hop has fewer blocks than that, whatever is left runs at once when the next frame falls due.
+
+// The fft engine transforms the whole window every hop; with hops of 64 or less that is mostly repeated
+// work. The sliding dft engine instead moves the bins under the filterbank along one sample at a time and
+// reads them off every hop, so its cost does not depend on the hop. It uses the periodic form of the
+// window, applied to the spectrum, where the fft engine uses the symmetric one, so frames differ very
+// slightly. The bins are reloaded from an fft once per window to keep rounding from building up. They are
+// only allocated while the engine is in use, so a detector on another engine carries none of their state.
+// Moving every bin every sample costs in proportion to the window, though, and in test/reference/engines.txt
+// it only draws level with the fft at a hop of 16, and is slower at every longer hop. Its frames come no
+// sooner than the fft engine's. Pick it for hops of 16 or less when the thresholds have to stay those of the
+// fft engine; otherwise the filterbank below is several times cheaper than either at short hops.
+
+// Either way a frame cannot see an onset until it is well inside the window. The filterbank engine has no
+// window: each Bark band is a pair of band-pass filters run on every sample, whose smoothed output power is
+// read off every hop as the band's level, so a rise shows within a hop or so of reaching the filters. The
+// filtering costs the same per sample whatever the hop, so hops of 64 or less are where it pays. A sine at a
+// band's centre reads about what the fft engine gives it, but the bands overlap more, so absolute thresholds
+// may need retuning.
+
+// Detectors with the same hop all run their frames on the same block unless their hops are out of phase.
+// By default each new detector takes the phase that keeps the busiest block of the whole process as light
+// as possible, counting the detectors that already exist. Phases never move once given, so events stay
+// reproducible for a fixed set of detectors, except that the scheduler picks again for its own when the
+// window or hop changes. Detectors are created, destroyed and rephased on one thread. A frame falls due on
+// the sample its phase gives whatever the block size, and the fft and filterbank engines end its window on
+// that sample; the sliding dft can only read its bins at the end of the block the frame falls due in.
+
+// Automatic thresholds are the upper and lower scales times a level taken from each channel's recent flux:
+// its mean, or a percentile of it (50 for the median). By default the history is the whole session, which
+// reacts more slowly the longer it runs; with average_ms it is only the frames of the last average_ms.
+// Either way updates cost O(log n) per frame at most. The percentile needs a windowed history.
+
+// Fills in the defaults: 1024 sample window, 256 sample hop, one channel at 44100 Hz, no worker, scheduled phase,
+// thresholds from the mean of the whole session, no callbacks
+void pod_config_init(t_pod_config* config);
+
+// Every kernel comes in a variant per instruction set, see pod_cpu.h, and one set is in use by every detector
+// at a time. pod_init picks the widest the processor has, once; pod_create calls it if the host has not.
+// pod_set_isa moves every detector to another set, or returns -1 if the build or the processor lacks it. It
+// finishes the frames detectors have in progress or out on a worker first, so their onsets can be reported
+// from inside the call. Call these from the thread that creates detectors, between blocks.
+void pod_init(void);
+t_pod_isa pod_get_isa(void);
+int pod_set_isa(t_pod_isa isa);
+
+t_pod* pod_create(const t_pod_config* config);
+void pod_destroy(t_pod* pod);
+
+// Filters n samples into the history and runs an analysis frame whenever a hop's worth has arrived. n may be
+// any length: a block longer than the hop runs in pieces ending where each of its frames falls due.
+void pod_process_block(t_pod* pod, const float* in, int n);
+
+// The same for a detector with several channels: in[channel] holds n samples for each one. Every channel
+// has its own filter state, history and peak picking, while the window, filterbank and fft plan are shared.
+void pod_process_channels(t_pod* pod, const float* const* in, int n);
+
+// Clears the signal history, filter state and peak picking state so the same input gives the same events
+// again. Parameters are kept.
+void pod_reset(t_pod* pod);
+
+// Stage timings since creation or the last pod_reset_profile. Returns -1 if built without POD_PROFILE.
+int pod_get_profile(const t_pod* pod, t_pod_profile* profile);
+void pod_reset_profile(t_pod* pod);
+const char* pod_stage_name(t_pod_stage stage);
+
+int pod_get_window_size(const t_pod* pod);
+int pod_get_hop_size(const t_pod* pod);
+int pod_get_channels(const t_pod* pod);
+float pod_get_sample_rate(const t_pod* pod);
+int pod_get_latency(const t_pod* pod);                          // 0 if the worker thread could not start
+int pod_get_phase(const t_pod* pod);
+int pod_get_spread(const t_pod* pod);                           // blocks from a frame falling due to its events, 0 if not spread
+void pod_get_schedule(t_pod_schedule* schedule);
+
+// Parameters; each returns 0 or -1 if the value was rejected
+// The Bark filterbank and every time given in ms follow the sample rate. The window and filterbank tables are
+// shared between detectors with the same window type, window size and sample rate, so setting a rate or window
+// type that another detector already uses costs no table work. Call these from the thread that creates
+// detectors, between blocks.
+int pod_set_window_type(t_pod* pod, int type);                  // 0 hanning, 1 hamming
+int pod_set_sample_rate(t_pod* pod, float sample_rate);
+// Both sizes are powers of two. The buffers for the new size are made before the old ones are let go, and the
+// history is kept, so analysis carries on from the next frame. Same threading rule as above.
+int pod_set_window_size(t_pod* pod, int size);
+int pod_set_hop_size(t_pod* pod, int size);
+int pod_set_phase(t_pod* pod, int phase);                       // samples, -1 to let the scheduler pick
+int pod_set_spread(t_pod* pod, int spread);                     // rejected with a worker thread, another engine than the fft or resolutions
+int pod_set_engine(t_pod* pod, int engine);                     // anything but the fft rejected with a worker thread, spreading or resolutions
+int pod_set_power(t_pod* pod, int power);                       // see config.power
+
+// Shorter windows analysed every hop alongside the main one, from the same filtered history and ending on the
+// same sample. The short windows react sooner but cannot resolve the narrow low bands, so each Bark band is
+// taken from the shortest window with at least four bins under it and the main window supplies the rest,
+// before one flux is found over them all. Sizes are powers of two from 64 to below the window size; a count of
+// 0 goes back to the main window alone. Rejected with spreading or another engine than the fft. Changing the window size
+// drops the ones that are no longer shorter. Same threading rule as the other table changes.
+int pod_set_resolutions(t_pod* pod, const int* sizes, int count);
+
+// Every window in use, the main one first, with the first Bark band each supplies. Returns how many.
+int pod_get_resolutions(const t_pod* pod, int* sizes, int* first_bands);
+
+// Largest difference between the sliding dft's magnitudes and an fft of the same samples and window,
+// relative to the largest magnitude. -1 if the detector is using the fft.
+float pod_check_engine(t_pod* pod);
+
+// Largest difference between isa's ear filter, window, magnitude, Bark, flux and filterbank kernels and the
+// scalar ones, run on noise with the detector's coefficients, window and filterbank, relative to the largest
+// scalar output. -1 if the processor or the build lacks isa. Main thread; leaves the detector as it was.
+float pod_check_isa(t_pod* pod, t_pod_isa isa);
+int pod_set_debounce_threshold(t_pod* pod, int frames);
+int pod_set_upper_threshold(t_pod* pod, float threshold);       // turns automatic thresholding off
+int pod_set_lower_threshold(t_pod* pod, float threshold);       // turns automatic thresholding off
+int pod_set_consecutive_threshold(t_pod* pod, float ms);
+int pod_set_upper_threshold_scale(t_pod* pod, float scale);     // turns automatic thresholding on
+int pod_set_lower_threshold_scale(t_pod* pod, float scale);     // turns automatic thresholding on
+void pod_reset_average(t_pod* pod);
+int pod_set_average_window(t_pod* pod, float ms);               // 0 for the whole session
+int pod_set_average_percentile(t_pod* pod, float percentile);   // 0 - 100, or -1 for the mean
+int pod_get_average(const t_pod* pod, int channel, t_pod_average* average);
+
+#endif
@@ -0,0 +1,333 @@
+//
+//  pod_bank.c
+//  pod
+//
+//
+// Copyright (C) 2012 Scott McCoid, Gregoire Tronel, Jay Clark
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy of this software
+// and associated documentation files (the "Software"), to deal in the Software without restriction,
+// including without limitation the rights to use, copy, modify, merge, publish, distribute, sublicense,
+// and/or sell copies of the Software, and to permit persons to whom the Software is furnished to do so,
+// subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in all copies or substantial
+// portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR IMPLIED, INCLUDING BUT NOT
+// LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.
+// IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY,
+// WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE
+// SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+
+#include "pod_bank.h"
+#include <math.h>
+#include <stdlib.h>
+#include <string.h>
+
+#if defined(POD_CPU_X86)
+#include <immintrin.h>
+#endif
+#if defined(POD_CPU_NEON)
+#include <arm_neon.h>
+#endif
+
+#define POD_BANK_PI 3.14159265358979323846
+#define POD_BANK_STAGE_WIDTH 1.5538             // 1 / sqrt(sqrt(2) - 1): two stages this wide pass the band at -3 dB
+
+// Per channel, one row of POD_BANK_BANDS for each piece of state
+enum { ROW_S1, ROW_S2, ROW_T1, ROW_T2, ROW_E1, ROW_E2, NUM_ROWS };
+
+struct _pod_bank
+{
+    int         channels;
+    float       gain[POD_BANK_BANDS];           // g, with the x(n-2) term at -g
+    float       a1[POD_BANK_BANDS];
+    float       a2[POD_BANK_BANDS];
+    float       smooth[POD_BANK_BANDS];         // one-pole coefficient of the envelope
+    float*      state;                          // NUM_ROWS rows per channel, channel after channel
+};
+
+typedef void (*t_bank_kernel)(t_pod_bank* bank, float* state, const float* in, int stride, int n);
+
+static t_pod_isa bank_isa = POD_ISA_SCALAR;    // see pod_bank_use
+
+#pragma mark - Setup -
+
+t_pod_bank* pod_bank_create(const int* edges, const int* centres, float sample_rate, int channels)
+{
+    t_pod_bank* bank = (t_pod_bank *)calloc(1, sizeof(t_pod_bank));
+    
+    if (bank == NULL)
+        return NULL;
+        
+    bank->channels = channels;
+    bank->state = (float *)calloc(NUM_ROWS * POD_BANK_BANDS * channels, sizeof(float));
+    
+    if (bank->state == NULL)
+    {
+        pod_bank_destroy(bank);
+        return NULL;
+    }
+    
+    // Constant peak gain band-pass biquads, each wide enough that the pair is -3 dB at the band's limits
+    for (int i = 0; i < POD_BANK_BANDS; i++)
+    {
+        if (edges[i + 1] >= sample_rate / 2.0)
+            continue;
+            
+        double width = edges[i + 1] - edges[i];
+        double w0 = 2.0 * POD_BANK_PI * centres[i] / sample_rate;
+        double alpha = sin(w0) * POD_BANK_STAGE_WIDTH * width / (2.0 * centres[i]);
+        double cutoff = width < centres[i] / 4.0 ? width : centres[i] / 4.0;
+        
+        bank->gain[i] = alpha / (1.0 + alpha);
+        bank->a1[i] = -2.0 * cos(w0) / (1.0 + alpha);
+        bank->a2[i] = (1.0 - alpha) / (1.0 + alpha);
+        bank->smooth[i] = 1.0 - exp(-2.0 * POD_BANK_PI * cutoff / sample_rate);
+    }
+    
+    return bank;
+}
+
+void pod_bank_destroy(t_pod_bank* bank)
+{
+    if (bank == NULL)
+        return;
+        
+    free(bank->state);
+    free(bank);
+}
+
+void pod_bank_reset(t_pod_bank* bank)
+{
+    memset(bank->state, 0, NUM_ROWS * POD_BANK_BANDS * bank->channels * sizeof(float));
+}
+
+#pragma mark - Kernels -
+
+// Each kernel runs one channel's n samples, in[i * stride], through every band. The bands are independent,
+// so the vector kernels take a group of them at a time through the whole run with its state in registers.
+//
+// Both stages are transposed direct form II; with b1 = 0 and b2 = -b0 each costs three multiplies:
+//      y = g x + s1,   s1 = s2 - a1 y,   s2 = -(g x + a2 y)
+
+static void bands_scalar(t_pod_bank* bank, float* state, const float* in, int stride, int n)
+{
+    for (int b = 0; b < POD_BANK_BANDS; b++)
+    {
+        float g = bank->gain[b], a1 = bank->a1[b], a2 = bank->a2[b], k = bank->smooth[b];
+        float s1 = state[ROW_S1 * POD_BANK_BANDS + b], s2 = state[ROW_S2 * POD_BANK_BANDS + b];
+        float t1 = state[ROW_T1 * POD_BANK_BANDS + b], t2 = state[ROW_T2 * POD_BANK_BANDS + b];
+        float e1 = state[ROW_E1 * POD_BANK_BANDS + b], e2 = state[ROW_E2 * POD_BANK_BANDS + b];
+        
+        for (int i = 0; i < n; i++)
+        {
+            float gx = g * in[i * stride];
+            float y = gx + s1;
+            s1 = s2 - a1 * y;
+            s2 = -(gx + a2 * y);
+            
+            float gy = g * y;
+            float z = gy + t1;
+            t1 = t2 - a1 * z;
+            t2 = -(gy + a2 * z);
+            
+            e1 += k * (z * z - e1);
+            e2 += k * (e1 - e2);
+        }
+        
+        state[ROW_S1 * POD_BANK_BANDS + b] = s1;
+        state[ROW_S2 * POD_BANK_BANDS + b] = s2;
+        state[ROW_T1 * POD_BANK_BANDS + b] = t1;
+        state[ROW_T2 * POD_BANK_BANDS + b] = t2;
+        state[ROW_E1 * POD_BANK_BANDS + b] = e1;
+        state[ROW_E2 * POD_BANK_BANDS + b] = e2;
+    }
+}
+
+#if defined(POD_CPU_X86)
+POD_TARGET("avx") static void bands_avx(t_pod_bank* bank, float* state, const float* in, int stride, int n)
+{
+    for (int b = 0; b < POD_BANK_BANDS; b += 8)
+    {
+        __m256 g = _mm256_loadu_ps(bank->gain + b);
+        __m256 a1 = _mm256_loadu_ps(bank->a1 + b);
+        __m256 a2 = _mm256_loadu_ps(bank->a2 + b);
+        __m256 k = _mm256_loadu_ps(bank->smooth + b);
+        __m256 s1 = _mm256_loadu_ps(state + ROW_S1 * POD_BANK_BANDS + b);
+        __m256 s2 = _mm256_loadu_ps(state + ROW_S2 * POD_BANK_BANDS + b);
+        __m256 t1 = _mm256_loadu_ps(state + ROW_T1 * POD_BANK_BANDS + b);
+        __m256 t2 = _mm256_loadu_ps(state + ROW_T2 * POD_BANK_BANDS + b);
+        __m256 e1 = _mm256_loadu_ps(state + ROW_E1 * POD_BANK_BANDS + b);
+        __m256 e2 = _mm256_loadu_ps(state + ROW_E2 * POD_BANK_BANDS + b);
+        __m256 zero = _mm256_setzero_ps();
+        
+        for (int i = 0; i < n; i++)
+        {
+            __m256 gx = _mm256_mul_ps(g, _mm256_set1_ps(in[i * stride]));
+            __m256 y = _mm256_add_ps(gx, s1);
+            s1 = _mm256_sub_ps(s2, _mm256_mul_ps(a1, y));
+            s2 = _mm256_sub_ps(zero, _mm256_add_ps(gx, _mm256_mul_ps(a2, y)));
+            
+            __m256 gy = _mm256_mul_ps(g, y);
+            __m256 z = _mm256_add_ps(gy, t1);
+            t1 = _mm256_sub_ps(t2, _mm256_mul_ps(a1, z));
+            t2 = _mm256_sub_ps(zero, _mm256_add_ps(gy, _mm256_mul_ps(a2, z)));
+            
+            e1 = _mm256_add_ps(e1, _mm256_mul_ps(k, _mm256_sub_ps(_mm256_mul_ps(z, z), e1)));
+            e2 = _mm256_add_ps(e2, _mm256_mul_ps(k, _mm256_sub_ps(e1, e2)));
+        }
+        
+        _mm256_storeu_ps(state + ROW_S1 * POD_BANK_BANDS + b, s1);
+        _mm256_storeu_ps(state + ROW_S2 * POD_BANK_BANDS + b, s2);
+        _mm256_storeu_ps(state + ROW_T1 * POD_BANK_BANDS + b, t1);
+        _mm256_storeu_ps(state + ROW_T2 * POD_BANK_BANDS + b, t2);
+        _mm256_storeu_ps(state + ROW_E1 * POD_BANK_BANDS + b, e1);
+        _mm256_storeu_ps(state + ROW_E2 * POD_BANK_BANDS + b, e2);
+    }
+}
+
+POD_TARGET("sse2") static void bands_sse(t_pod_bank* bank, float* state, const float* in, int stride, int n)
+{
+    for (int b = 0; b < POD_BANK_BANDS; b += 4)
+    {
+        __m128 g = _mm_loadu_ps(bank->gain + b);
+        __m128 a1 = _mm_loadu_ps(bank->a1 + b);
+        __m128 a2 = _mm_loadu_ps(bank->a2 + b);
+        __m128 k = _mm_loadu_ps(bank->smooth + b);
+        __m128 s1 = _mm_loadu_ps(state + ROW_S1 * POD_BANK_BANDS + b);
+        __m128 s2 = _mm_loadu_ps(state + ROW_S2 * POD_BANK_BANDS + b);
+        __m128 t1 = _mm_loadu_ps(state + ROW_T1 * POD_BANK_BANDS + b);
+        __m128 t2 = _mm_loadu_ps(state + ROW_T2 * POD_BANK_BANDS + b);
+        __m128 e1 = _mm_loadu_ps(state + ROW_E1 * POD_BANK_BANDS + b);
+        __m128 e2 = _mm_loadu_ps(state + ROW_E2 * POD_BANK_BANDS + b);
+        __m128 zero = _mm_setzero_ps();
+        
+        for (int i = 0; i < n; i++)
+        {
+            __m128 gx = _mm_mul_ps(g, _mm_set1_ps(in[i * stride]));
+            __m128 y = _mm_add_ps(gx, s1);
+            s1 = _mm_sub_ps(s2, _mm_mul_ps(a1, y));
+            s2 = _mm_sub_ps(zero, _mm_add_ps(gx, _mm_mul_ps(a2, y)));
+            
+            __m128 gy = _mm_mul_ps(g, y);
+            __m128 z = _mm_add_ps(gy, t1);
+            t1 = _mm_sub_ps(t2, _mm_mul_ps(a1, z));
+            t2 = _mm_sub_ps(zero, _mm_add_ps(gy, _mm_mul_ps(a2, z)));
+            
+            e1 = _mm_add_ps(e1, _mm_mul_ps(k, _mm_sub_ps(_mm_mul_ps(z, z), e1)));
+            e2 = _mm_add_ps(e2, _mm_mul_ps(k, _mm_sub_ps(e1, e2)));
+        }
+        
+        _mm_storeu_ps(state + ROW_S1 * POD_BANK_BANDS + b, s1);
+        _mm_storeu_ps(state + ROW_S2 * POD_BANK_BANDS + b, s2);
+        _mm_storeu_ps(state + ROW_T1 * POD_BANK_BANDS + b, t1);
+        _mm_storeu_ps(state + ROW_T2 * POD_BANK_BANDS + b, t2);
+        _mm_storeu_ps(state + ROW_E1 * POD_BANK_BANDS + b, e1);
+        _mm_storeu_ps(state + ROW_E2 * POD_BANK_BANDS + b, e2);
+    }
+}
+#endif
+
+#if defined(POD_CPU_NEON)
+static void bands_neon(t_pod_bank* bank, float* state, const float* in, int stride, int n)
+{
+    for (int b = 0; b < POD_BANK_BANDS; b += 4)
+    {
+        float32x4_t g = vld1q_f32(bank->gain + b);
+        float32x4_t a1 = vld1q_f32(bank->a1 + b);
+        float32x4_t a2 = vld1q_f32(bank->a2 + b);
+        float32x4_t k = vld1q_f32(bank->smooth + b);
+        float32x4_t s1 = vld1q_f32(state + ROW_S1 * POD_BANK_BANDS + b);
+        float32x4_t s2 = vld1q_f32(state + ROW_S2 * POD_BANK_BANDS + b);
+        float32x4_t t1 = vld1q_f32(state + ROW_T1 * POD_BANK_BANDS + b);
+        float32x4_t t2 = vld1q_f32(state + ROW_T2 * POD_BANK_BANDS + b);
+        float32x4_t e1 = vld1q_f32(state + ROW_E1 * POD_BANK_BANDS + b);
+        float32x4_t e2 = vld1q_f32(state + ROW_E2 * POD_BANK_BANDS + b);
+        
+        for (int i = 0; i < n; i++)
+        {
+            float32x4_t gx = vmulq_n_f32(g, in[i * stride]);
+            float32x4_t y = vaddq_f32(gx, s1);
+            s1 = vmlsq_f32(s2, a1, y);
+            s2 = vnegq_f32(vmlaq_f32(gx, a2, y));
+            
+            float32x4_t gy = vmulq_f32(g, y);
+            float32x4_t z = vaddq_f32(gy, t1);
+            t1 = vmlsq_f32(t2, a1, z);
+            t2 = vnegq_f32(vmlaq_f32(gy, a2, z));
+            
+            e1 = vmlaq_f32(e1, k, vsubq_f32(vmulq_f32(z, z), e1));
+            e2 = vmlaq_f32(e2, k, vsubq_f32(e1, e2));
+        }
+        
+        vst1q_f32(state + ROW_S1 * POD_BANK_BANDS + b, s1);
+        vst1q_f32(state + ROW_S2 * POD_BANK_BANDS + b, s2);
+        vst1q_f32(state + ROW_T1 * POD_BANK_BANDS + b, t1);
+        vst1q_f32(state + ROW_T2 * POD_BANK_BANDS + b, t2);
+        vst1q_f32(state + ROW_E1 * POD_BANK_BANDS + b, e1);
+        vst1q_f32(state + ROW_E2 * POD_BANK_BANDS + b, e2);
+    }
+}
+#endif
+
+static t_bank_kernel bank_kernel(t_pod_isa isa)
+{
+    // 24 bands are three groups of eight, so AVX-512 runs the AVX kernel
+    switch (isa)
+    {
+#if defined(POD_CPU_X86)
+        case POD_ISA_SSE2:
+            return bands_sse;
+            
+        case POD_ISA_AVX2:
+        case POD_ISA_AVX512:
+            return bands_avx;
+#endif
+#if defined(POD_CPU_NEON)
+        case POD_ISA_NEON:
+            return bands_neon;
+#endif
+        default:
+            return bands_scalar;
+    }
+}
+
+#pragma mark - Bank -
+
+void pod_bank_use(t_pod_isa isa)
+{
+    bank_isa = pod_cpu_supports(isa) ? isa : POD_ISA_SCALAR;
+}
+
+void pod_bank_update(t_pod_bank* bank, const float* history, int history_size, int start, int n)
+{
+    pod_bank_update_isa(bank, history, history_size, start, n, bank_isa);
+}
+
+void pod_bank_update_isa(t_pod_bank* bank, const float* history, int history_size, int start, int n, t_pod_isa isa)
+{
+    t_bank_kernel kernel = bank_kernel(isa);
+    int channels = bank->channels;
+    int first = history_size - start < n ? history_size - start : n;
+    
+    // up to the end of the history, then on from its start
+    for (int c = 0; c < channels; c++)
+    {
+        float* state = bank->state + c * NUM_ROWS * POD_BANK_BANDS;
+        
+        kernel(bank, state, history + start * channels + c, channels, first);
+        if (first < n)
+            kernel(bank, state, history + c, channels, n - first);
+    }
+}
+
+void pod_bank_envelopes(const t_pod_bank* bank, int channel, float* out, int power)
+{
+    const float* envelope = bank->state + (channel * NUM_ROWS + ROW_E2) * POD_BANK_BANDS;
+    
+    // the envelope is the mean square, half the square of a sine's amplitude
+    for (int b = 0; b < POD_BANK_BANDS; b++)
+        out[b] = power ? envelope[b] * (3.0 / 16.0) : sqrtf(envelope[b] * 0.5);
+}
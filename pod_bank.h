@@ -0,0 +1,63 @@
+//
+//  pod_bank.h
+//  pod
+//
+//
+// Copyright (C) 2012 Scott McCoid, Gregoire Tronel, Jay Clark
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy of this software
+// and associated documentation files (the "Software"), to deal in the Software without restriction,
+// including without limitation the rights to use, copy, modify, merge, publish, distribute, sublicense,
+// and/or sell copies of the Software, and to permit persons to whom the Software is furnished to do so,
+// subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in all copies or substantial
+// portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR IMPLIED, INCLUDING BUT NOT
+// LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.
+// IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY,
+// WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE
+// SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+
+
+// The Bark bands as a bank of band-pass filters on the time signal, for onsets sooner than a window allows.
+// Each band is two identical resonators in cascade,
+//      y(n) = g x(n) - g x(n-2) - a1 y(n-1) - a2 y(n-2)
+// tuned so the pair passes the band between its Bark limits, and the square of its output is smoothed into
+// an envelope by two one-pole lowpasses. The smoothing cutoff is the band's width or a quarter of its centre,
+// whichever is lower, so the envelope follows the band as fast as it can without rippling at twice the centre.
+//
+// Every sample runs all the bands, so the vector kernels take four (SSE2, NEON) or eight (AVX) bands at once
+// with the one input sample in every lane. Bands above the Nyquist frequency stay silent.
+
+#ifndef POD_BANK_H
+#define POD_BANK_H
+
+#include "pod_cpu.h"
+
+#define POD_BANK_BANDS 24
+
+typedef struct _pod_bank t_pod_bank;
+
+// edges holds the POD_BANK_BANDS + 1 band limits in Hz and centres each band's centre. All zero to start with.
+t_pod_bank* pod_bank_create(const int* edges, const int* centres, float sample_rate, int channels);
+void pod_bank_destroy(t_pod_bank* bank);
+void pod_bank_reset(t_pod_bank* bank);
+
+// Picks the kernels pod_bank_update runs from now on, for every bank. An isa the processor lacks picks the
+// scalar ones. Main thread, between blocks.
+void pod_bank_use(t_pod_isa isa);
+
+// Runs every channel through the bank for the n frames starting at start in history, a circular buffer of
+// history_size frames (a power of two) with channels interleaved
+void pod_bank_update(t_pod_bank* bank, const float* history, int history_size, int start, int n);
+
+// The same with isa's kernels whatever pod_bank_use picked, for checking them. isa must be supported.
+void pod_bank_update_isa(t_pod_bank* bank, const float* history, int history_size, int start, int n, t_pod_isa isa);
+
+// One channel's envelopes, POD_BANK_BANDS of them. A sine at a band's centre reads what the fft engine's
+// hanning window gives it: half its amplitude, or 3 / 32 of its square when power is set.
+void pod_bank_envelopes(const t_pod_bank* bank, int channel, float* out, int power);
+
+#endif
@@ -0,0 +1,73 @@
+//
+//  pod_cpu.c
+//  pod
+//
+//
+// Copyright (C) 2012 Scott McCoid, Gregoire Tronel, Jay Clark
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy of this software
+// and associated documentation files (the "Software"), to deal in the Software without restriction,
+// including without limitation the rights to use, copy, modify, merge, publish, distribute, sublicense,
+// and/or sell copies of the Software, and to permit persons to whom the Software is furnished to do so,
+// subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in all copies or substantial
+// portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR IMPLIED, INCLUDING BUT NOT
+// LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.
+// IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY,
+// WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE
+// SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+
+
+
+#include "pod_cpu.h"
+
+static const char* isa_names[POD_NUM_ISAS] = { "scalar", "sse2", "avx2", "avx512", "neon" };
+
+int pod_cpu_supports(t_pod_isa isa)
+{
+    switch (isa)
+    {
+        case POD_ISA_SCALAR:
+            return 1;
+            
+#if defined(POD_CPU_X86)
+        // cpuid, and for the wide sets whether the OS saves their registers
+        case POD_ISA_SSE2:
+            __builtin_cpu_init();
+            return __builtin_cpu_supports("sse2") != 0;
+            
+        case POD_ISA_AVX2:
+            __builtin_cpu_init();
+            return __builtin_cpu_supports("avx2") != 0;
+            
+        case POD_ISA_AVX512:
+            __builtin_cpu_init();
+            return __builtin_cpu_supports("avx512f") != 0;
+#endif
+            
+#if defined(POD_CPU_NEON)
+        case POD_ISA_NEON:
+            return 1;
+#endif
+            
+        default:
+            return 0;
+    }
+}
+
+t_pod_isa pod_cpu_best(void)
+{
+    for (int isa = POD_NUM_ISAS - 1; isa > POD_ISA_SCALAR; isa--)
+        if (pod_cpu_supports((t_pod_isa)isa))
+            return (t_pod_isa)isa;
+            
+    return POD_ISA_SCALAR;
+}
+
+const char* pod_cpu_name(t_pod_isa isa)
+{
+    return (isa >= 0 && isa < POD_NUM_ISAS) ? isa_names[isa] : "unknown";
+}
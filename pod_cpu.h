@@ -0,0 +1,63 @@
+//
+//  pod_cpu.h
+//  pod
+//
+//
+// Copyright (C) 2012 Scott McCoid, Gregoire Tronel, Jay Clark
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy of this software
+// and associated documentation files (the "Software"), to deal in the Software without restriction,
+// including without limitation the rights to use, copy, modify, merge, publish, distribute, sublicense,
+// and/or sell copies of the Software, and to permit persons to whom the Software is furnished to do so,
+// subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in all copies or substantial
+// portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR IMPLIED, INCLUDING BUT NOT
+// LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.
+// IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY,
+// WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE
+// SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+
+
+
+// The instruction sets the DSP kernels come in. One binary carries a variant of each kernel for every set its
+// compiler can target on the architecture it was built for, each compiled with that set enabled for the one
+// function, so the binary as a whole still runs on any processor of the architecture. Which variants run is
+// decided at load time from what the processor reports.
+//
+// NEON is part of every arm64 processor, so it is picked at build time rather than probed.
+
+#ifndef POD_CPU_H
+#define POD_CPU_H
+
+#if (defined(__x86_64__) || defined(__i386__)) && defined(__GNUC__)
+#define POD_CPU_X86 1
+#define POD_TARGET(features) __attribute__((target(features)))
+#endif
+
+#if defined(__ARM_NEON) || defined(__ARM_NEON__)
+#define POD_CPU_NEON 1
+#endif
+
+typedef enum _pod_isa
+{
+    POD_ISA_SCALAR,                             // plain C, the reference the others are checked against
+    POD_ISA_SSE2,
+    POD_ISA_AVX2,
+    POD_ISA_AVX512,                             // AVX-512F
+    POD_ISA_NEON,
+    POD_NUM_ISAS
+    
+} t_pod_isa;
+
+// 1 if this build has variants for isa and the processor can run them
+int pod_cpu_supports(t_pod_isa isa);
+
+// The widest set pod_cpu_supports
+t_pod_isa pod_cpu_best(void);
+
+const char* pod_cpu_name(t_pod_isa isa);
+
+#endif
@@ -0,0 +1,476 @@
+//
+//  pod_fft.c
+//  pod
+//
+//
+// Copyright (C) 2012 Scott McCoid, Gregoire Tronel, Jay Clark
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy of this software
+// and associated documentation files (the "Software"), to deal in the Software without restriction,
+// including without limitation the rights to use, copy, modify, merge, publish, distribute, sublicense,
+// and/or sell copies of the Software, and to permit persons to whom the Software is furnished to do so,
+// subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in all copies or substantial
+// portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR IMPLIED, INCLUDING BUT NOT
+// LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.
+// IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY,
+// WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE
+// SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+
+
+#include "pod_fft.h"
+#include <math.h>
+#include <stdlib.h>
+#include <string.h>
+
+#if defined(POD_CPU_X86)
+#include <immintrin.h>
+#endif
+#if defined(POD_CPU_NEON)
+#include <arm_neon.h>
+#endif
+
+#if defined(POD_FFT_PFFFT)
+#include "pffft.h"
+#elif defined(POD_FFT_FFTW)
+#include <fftw3.h>
+#endif
+
+#define POD_FFT_PI 3.14159265358979323846
+
+struct _pod_fft_plan
+{
+    int                 size;
+    int                 refcount;
+    t_pod_fft_plan*     next;
+    
+    // built-in transform: a size/2 point complex fft followed by a split into the real spectrum
+    int*                bitrev;                 // size/2 bit reversed indices
+    float*              twiddle;                // size/4 (cos, sin) pairs for the complex stages
+    float*              split;                  // size/2 + 1 (cos, sin) pairs for the split
+    
+#if defined(POD_FFT_PFFFT)
+    PFFFT_Setup*        setup;
+#elif defined(POD_FFT_FFTW)
+    fftwf_plan          fftw;
+#endif
+};
+
+static t_pod_fft_plan* plans = NULL;            // every live plan, one per size
+static t_pod_isa magnitudes_isa = POD_ISA_SCALAR;   // see pod_fft_use
+
+#pragma mark - Buffers -
+
+float* pod_fft_alloc(int count)
+{
+    void* buffer = NULL;
+    size_t bytes = ((count * sizeof(float) + POD_FFT_ALIGNMENT - 1) / POD_FFT_ALIGNMENT) * POD_FFT_ALIGNMENT;
+    
+    if (posix_memalign(&buffer, POD_FFT_ALIGNMENT, bytes) != 0)
+        return NULL;
+    
+    memset(buffer, 0, bytes);
+    return (float *)buffer;
+}
+
+void pod_fft_free(float* buffer)
+{
+    free(buffer);
+}
+
+#pragma mark - Built-in Transform -
+
+static int builtin_create(t_pod_fft_plan* plan)
+{
+    int half = plan->size / 2;
+    int bits = 0;
+    
+    while ((1 << bits) < half)
+        bits++;
+    
+    plan->bitrev = (int *)malloc(half * sizeof(int));
+    plan->twiddle = pod_fft_alloc(half > 1 ? half : 2);
+    plan->split = pod_fft_alloc(2 * (half + 1));
+    
+    if (plan->bitrev == NULL || plan->twiddle == NULL || plan->split == NULL)
+        return -1;
+    
+    for (int i = 0; i < half; i++)
+    {
+        int r = 0;
+        for (int b = 0; b < bits; b++)
+            r |= ((i >> b) & 1) << (bits - 1 - b);
+        plan->bitrev[i] = r;
+    }
+    
+    for (int i = 0; i < half / 2; i++)
+    {
+        plan->twiddle[2 * i] = cos(2.0 * POD_FFT_PI * i / half);
+        plan->twiddle[2 * i + 1] = -sin(2.0 * POD_FFT_PI * i / half);
+    }
+    
+    for (int i = 0; i <= half; i++)
+    {
+        plan->split[2 * i] = cos(2.0 * POD_FFT_PI * i / plan->size);
+        plan->split[2 * i + 1] = -sin(2.0 * POD_FFT_PI * i / plan->size);
+    }
+    
+    return 0;
+}
+
+static void builtin_destroy(t_pod_fft_plan* plan)
+{
+    free(plan->bitrev);
+    pod_fft_free(plan->twiddle);
+    pod_fft_free(plan->split);
+}
+
+static void builtin_forward(t_pod_fft_plan* plan, const float* in, float* out)
+{
+    int half = plan->size / 2;
+    
+    // Pack even samples as real and odd samples as imaginary parts, in bit reversed order
+    for (int i = 0; i < half; i++)
+    {
+        int r = plan->bitrev[i];
+        out[2 * r] = in[2 * i];
+        out[2 * r + 1] = in[2 * i + 1];
+    }
+    
+    // Radix-2 decimation in time over the size/2 complex points
+    for (int length = 2; length <= half; length <<= 1)
+    {
+        int span = length / 2;
+        int stride = half / length;
+        
+        for (int start = 0; start < half; start += length)
+        {
+            for (int j = 0; j < span; j++)
+            {
+                float wr = plan->twiddle[2 * j * stride];
+                float wi = plan->twiddle[2 * j * stride + 1];
+                float* a = out + 2 * (start + j);
+                float* b = out + 2 * (start + j + span);
+                float vr = b[0] * wr - b[1] * wi;
+                float vi = b[0] * wi + b[1] * wr;
+                
+                b[0] = a[0] - vr;
+                b[1] = a[1] - vi;
+                a[0] += vr;
+                a[1] += vi;
+            }
+        }
+    }
+    
+    // Split the packed transform into the spectrum of the real input, bins k and half - k at a time
+    float z0r = out[0], z0i = out[1];
+    out[0] = z0r + z0i;
+    out[1] = 0.0;
+    out[2 * half] = z0r - z0i;
+    out[2 * half + 1] = 0.0;
+    
+    for (int k = 1; k <= half / 2; k++)
+    {
+        float* zk = out + 2 * k;
+        float* zm = out + 2 * (half - k);
+        float wr = plan->split[2 * k], wi = plan->split[2 * k + 1];
+        
+        float er = 0.5 * (zk[0] + zm[0]);       // even part: (Z[k] + conj(Z[half - k])) / 2
+        float ei = 0.5 * (zk[1] - zm[1]);
+        float or_ = 0.5 * (zk[1] + zm[1]);      // odd part: (Z[k] - conj(Z[half - k])) / 2i
+        float oi = -0.5 * (zk[0] - zm[0]);
+        float tr = wr * or_ - wi * oi;
+        float ti = wr * oi + wi * or_;
+        
+        zk[0] = er + tr;
+        zk[1] = ei + ti;
+        zm[0] = er - tr;                        // X[half - k] = conj(even - W^k * odd)
+        zm[1] = -(ei - ti);
+    }
+}
+
+#pragma mark - Plans -
+
+t_pod_fft_plan* pod_fft_plan_acquire(int size)
+{
+    for (t_pod_fft_plan* plan = plans; plan != NULL; plan = plan->next)
+    {
+        if (plan->size == size)
+        {
+            plan->refcount++;
+            return plan;
+        }
+    }
+    
+    t_pod_fft_plan* plan = (t_pod_fft_plan *)calloc(1, sizeof(t_pod_fft_plan));
+    if (plan == NULL)
+        return NULL;
+    
+    plan->size = size;
+    plan->refcount = 1;
+    
+    // The built-in tables are always made so a backend that can't handle the size can fall back to them
+    if (builtin_create(plan) != 0)
+    {
+        builtin_destroy(plan);
+        free(plan);
+        return NULL;
+    }
+    
+#if defined(POD_FFT_PFFFT)
+    plan->setup = pffft_new_setup(size, PFFFT_REAL);
+#elif defined(POD_FFT_FFTW)
+    // without room to measure in, the size falls back to the built-in transform like one fftw can't plan
+    float* in = pod_fft_alloc(size);
+    float* out = pod_fft_alloc(size + 2);
+    if (in != NULL && out != NULL)
+        plan->fftw = fftwf_plan_dft_r2c_1d(size, in, (fftwf_complex *)out, FFTW_MEASURE);
+    pod_fft_free(in);
+    pod_fft_free(out);
+#endif
+    
+    plan->next = plans;
+    plans = plan;
+    return plan;
+}
+
+void pod_fft_plan_release(t_pod_fft_plan* plan)
+{
+    if (plan == NULL || --plan->refcount > 0)
+        return;
+    
+    for (t_pod_fft_plan** link = &plans; *link != NULL; link = &(*link)->next)
+    {
+        if (*link == plan)
+        {
+            *link = plan->next;
+            break;
+        }
+    }
+    
+#if defined(POD_FFT_PFFFT)
+    if (plan->setup)
+        pffft_destroy_setup(plan->setup);
+#elif defined(POD_FFT_FFTW)
+    if (plan->fftw)
+        fftwf_destroy_plan(plan->fftw);
+#endif
+    
+    builtin_destroy(plan);
+    free(plan);
+}
+
+void pod_fft_forward(t_pod_fft_plan* plan, const float* in, float* out, float* work)
+{
+#if defined(POD_FFT_PFFFT)
+    if (plan->setup)
+    {
+        // pffft packs the real Nyquist bin into the imaginary slot of DC
+        pffft_transform_ordered(plan->setup, in, out, work, PFFFT_FORWARD);
+        out[plan->size] = out[1];
+        out[plan->size + 1] = 0.0;
+        out[1] = 0.0;
+        return;
+    }
+#elif defined(POD_FFT_FFTW)
+    if (plan->fftw)
+    {
+        fftwf_execute_dft_r2c(plan->fftw, (float *)in, (fftwf_complex *)out);
+        return;
+    }
+#endif
+    
+    (void)work;
+    builtin_forward(plan, in, out);
+}
+
+#pragma mark - Magnitudes -
+
+#if defined(POD_CPU_X86)
+POD_TARGET("sse2") static int magnitudes_sse(const float* spectrum, float* out, int stride, int from, int to, int power)
+{
+    float lanes[4];
+    int i = from;
+    
+    // two loads hold four (re, im) pairs; the shuffles split them into four re and four im
+    for (; i + 4 <= to; i += 4)
+    {
+        __m128 a = _mm_loadu_ps(spectrum + 2 * i);
+        __m128 b = _mm_loadu_ps(spectrum + 2 * i + 4);
+        __m128 re = _mm_shuffle_ps(a, b, _MM_SHUFFLE(2, 0, 2, 0));
+        __m128 im = _mm_shuffle_ps(a, b, _MM_SHUFFLE(3, 1, 3, 1));
+        __m128 p = _mm_add_ps(_mm_mul_ps(re, re), _mm_mul_ps(im, im));
+        
+        if (! power)
+            p = _mm_sqrt_ps(p);
+            
+        if (stride == 1)
+            _mm_storeu_ps(out + i, p);
+        else
+        {
+            _mm_storeu_ps(lanes, p);
+            for (int k = 0; k < 4; k++)
+                out[(i + k) * stride] = lanes[k];
+        }
+    }
+    
+    return i;
+}
+
+POD_TARGET("avx2") static int magnitudes_avx2(const float* spectrum, float* out, int stride, int from, int to, int power)
+{
+    float lanes[8];
+    int i = from;
+    
+    // the shuffles work within each 128 bit half, which leaves the bins as 0 1 4 5 2 3 6 7; one permute of the
+    // result puts them back in order
+    for (; i + 8 <= to; i += 8)
+    {
+        __m256 a = _mm256_loadu_ps(spectrum + 2 * i);
+        __m256 b = _mm256_loadu_ps(spectrum + 2 * i + 8);
+        __m256 re = _mm256_shuffle_ps(a, b, _MM_SHUFFLE(2, 0, 2, 0));
+        __m256 im = _mm256_shuffle_ps(a, b, _MM_SHUFFLE(3, 1, 3, 1));
+        __m256 p = _mm256_add_ps(_mm256_mul_ps(re, re), _mm256_mul_ps(im, im));
+        
+        p = _mm256_castpd_ps(_mm256_permute4x64_pd(_mm256_castps_pd(p), _MM_SHUFFLE(3, 1, 2, 0)));
+        if (! power)
+            p = _mm256_sqrt_ps(p);
+            
+        if (stride == 1)
+            _mm256_storeu_ps(out + i, p);
+        else
+        {
+            _mm256_storeu_ps(lanes, p);
+            for (int k = 0; k < 8; k++)
+                out[(i + k) * stride] = lanes[k];
+        }
+    }
+    
+    return i;
+}
+
+POD_TARGET("avx512f") static int magnitudes_avx512(const float* spectrum, float* out, int stride, int from, int to, int power)
+{
+    float lanes[16];
+    int i = from;
+    
+    // one two-source permute per half picks the sixteen re and the sixteen im out of two loads
+    const __m512i even = _mm512_setr_epi32(0, 2, 4, 6, 8, 10, 12, 14, 16, 18, 20, 22, 24, 26, 28, 30);
+    const __m512i odd = _mm512_setr_epi32(1, 3, 5, 7, 9, 11, 13, 15, 17, 19, 21, 23, 25, 27, 29, 31);
+    
+    for (; i + 16 <= to; i += 16)
+    {
+        __m512 a = _mm512_loadu_ps(spectrum + 2 * i);
+        __m512 b = _mm512_loadu_ps(spectrum + 2 * i + 16);
+        __m512 re = _mm512_permutex2var_ps(a, even, b);
+        __m512 im = _mm512_permutex2var_ps(a, odd, b);
+        __m512 p = _mm512_add_ps(_mm512_mul_ps(re, re), _mm512_mul_ps(im, im));
+        
+        if (! power)
+            p = _mm512_sqrt_ps(p);
+            
+        if (stride == 1)
+            _mm512_storeu_ps(out + i, p);
+        else
+        {
+            _mm512_storeu_ps(lanes, p);
+            for (int k = 0; k < 16; k++)
+                out[(i + k) * stride] = lanes[k];
+        }
+    }
+    
+    return i;
+}
+#endif
+
+#if defined(__aarch64__) && defined(POD_CPU_NEON)
+static int magnitudes_neon(const float* spectrum, float* out, int stride, int from, int to, int power)
+{
+    float lanes[4];
+    int i = from;
+    
+    // vld2q splits four (re, im) pairs on the way in
+    for (; i + 4 <= to; i += 4)
+    {
+        float32x4x2_t z = vld2q_f32(spectrum + 2 * i);
+        float32x4_t p = vmlaq_f32(vmulq_f32(z.val[0], z.val[0]), z.val[1], z.val[1]);
+        
+        if (! power)
+            p = vsqrtq_f32(p);
+            
+        if (stride == 1)
+            vst1q_f32(out + i, p);
+        else
+        {
+            vst1q_f32(lanes, p);
+            for (int k = 0; k < 4; k++)
+                out[(i + k) * stride] = lanes[k];
+        }
+    }
+    
+    return i;
+}
+#endif
+
+void pod_fft_use(t_pod_isa isa)
+{
+    magnitudes_isa = pod_cpu_supports(isa) ? isa : POD_ISA_SCALAR;
+}
+
+void pod_fft_magnitudes(const float* spectrum, float* out, int stride, int from, int to, int power)
+{
+    pod_fft_magnitudes_isa(spectrum, out, stride, from, to, power, magnitudes_isa);
+}
+
+void pod_fft_magnitudes_isa(const float* spectrum, float* out, int stride, int from, int to, int power, t_pod_isa isa)
+{
+    int i = from;
+    
+    // whole vectors first, whatever is left one bin at a time
+    switch (isa)
+    {
+#if defined(POD_CPU_X86)
+        case POD_ISA_SSE2:
+            i = magnitudes_sse(spectrum, out, stride, from, to, power);
+            break;
+            
+        case POD_ISA_AVX2:
+            i = magnitudes_avx2(spectrum, out, stride, from, to, power);
+            break;
+            
+        case POD_ISA_AVX512:
+            i = magnitudes_avx512(spectrum, out, stride, from, to, power);
+            break;
+#endif
+#if defined(__aarch64__) && defined(POD_CPU_NEON)
+        case POD_ISA_NEON:
+            i = magnitudes_neon(spectrum, out, stride, from, to, power);
+            break;
+#endif
+        default:
+            break;
+    }
+    
+    for (; i < to; i++)
+    {
+        float re = spectrum[2 * i];
+        float im = spectrum[2 * i + 1];
+        float p = (re * re) + (im * im);
+        
+        out[i * stride] = power ? p : sqrtf(p);
+    }
+}
+
+const char* pod_fft_backend_name(void)
+{
+#if defined(POD_FFT_PFFFT)
+    return "pffft";
+#elif defined(POD_FFT_FFTW)
+    return "fftw";
+#else
+    return "built-in";
+#endif
+}
@@ -0,0 +1,66 @@
+//
+//  pod_fft.h
+//  pod
+//
+//
+// Copyright (C) 2012 Scott McCoid, Gregoire Tronel, Jay Clark
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy of this software
+// and associated documentation files (the "Software"), to deal in the Software without restriction,
+// including without limitation the rights to use, copy, modify, merge, publish, distribute, sublicense,
+// and/or sell copies of the Software, and to permit persons to whom the Software is furnished to do so,
+// subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in all copies or substantial
+// portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR IMPLIED, INCLUDING BUT NOT
+// LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.
+// IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY,
+// WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE
+// SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+
+
+// Real forward FFT behind one interface, with the backend chosen at build time:
+//
+//      -DPOD_FFT_PFFFT     pffft (SIMD, sizes that are multiples of 32)
+//      -DPOD_FFT_FFTW      FFTW single precision
+//      (neither)           the built-in radix-2 transform
+//
+// Plans are shared: every caller asking for the same size gets the same refcounted plan. Plans are created
+// and released from the main thread only; running a plan is safe from any thread.
+//
+// Output is the spectrum of bins 0 .. size/2 as interleaved (re, im) pairs, so it needs size + 2 floats.
+// Nothing is scaled.
+
+#ifndef POD_FFT_H
+#define POD_FFT_H
+
+#include "pod_cpu.h"
+
+#define POD_FFT_ALIGNMENT 64
+
+typedef struct _pod_fft_plan t_pod_fft_plan;
+
+t_pod_fft_plan* pod_fft_plan_acquire(int size);
+void pod_fft_plan_release(t_pod_fft_plan* plan);
+
+// in holds size samples, out size + 2 floats and work size floats. All three must come from pod_fft_alloc.
+void pod_fft_forward(t_pod_fft_plan* plan, const float* in, float* out, float* work);
+
+// Bins from .. to - 1 of a spectrum from pod_fft_forward as magnitudes, or as power (their squares) when
+// power is set. Bin i goes to out[i * stride].
+void pod_fft_magnitudes(const float* spectrum, float* out, int stride, int from, int to, int power);
+
+// Picks the vector kernel pod_fft_magnitudes runs from now on; an isa the processor lacks picks plain C.
+// Main thread, between blocks. The _isa form runs a given, supported, isa's kernel for checking it.
+void pod_fft_use(t_pod_isa isa);
+void pod_fft_magnitudes_isa(const float* spectrum, float* out, int stride, int from, int to, int power, t_pod_isa isa);
+
+const char* pod_fft_backend_name(void);
+
+// Zeroed, POD_FFT_ALIGNMENT aligned float buffers
+float* pod_fft_alloc(int count);
+void pod_fft_free(float* buffer);
+
+#endif
@@ -0,0 +1,142 @@
+//
+//  pod_sdft.c
+//  pod
+//
+//
+// Copyright (C) 2012 Scott McCoid, Gregoire Tronel, Jay Clark
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy of this software
+// and associated documentation files (the "Software"), to deal in the Software without restriction,
+// including without limitation the rights to use, copy, modify, merge, publish, distribute, sublicense,
+// and/or sell copies of the Software, and to permit persons to whom the Software is furnished to do so,
+// subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in all copies or substantial
+// portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR IMPLIED, INCLUDING BUT NOT
+// LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.
+// IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY,
+// WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE
+// SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+
+
+#include "pod_sdft.h"
+#include <math.h>
+#include <stdlib.h>
+
+#define POD_SDFT_PI 3.14159265358979323846
+
+struct _pod_sdft
+{
+    int         size;
+    int         bins;
+    int         channels;
+    double*     re;                             // bins per channel, channel after channel
+    double*     im;
+    double*     rotate_re;                      // e^(j 2 pi k / size), one per bin
+    double*     rotate_im;
+};
+
+t_pod_sdft* pod_sdft_create(int size, int bins, int channels)
+{
+    t_pod_sdft* sdft = (t_pod_sdft *)calloc(1, sizeof(t_pod_sdft));
+    
+    if (sdft == NULL)
+        return NULL;
+    
+    sdft->size = size;
+    sdft->bins = bins;
+    sdft->channels = channels;
+    sdft->re = (double *)calloc(bins * channels, sizeof(double));
+    sdft->im = (double *)calloc(bins * channels, sizeof(double));
+    sdft->rotate_re = (double *)malloc(bins * sizeof(double));
+    sdft->rotate_im = (double *)malloc(bins * sizeof(double));
+    
+    if (sdft->re == NULL || sdft->im == NULL || sdft->rotate_re == NULL || sdft->rotate_im == NULL)
+    {
+        pod_sdft_destroy(sdft);
+        return NULL;
+    }
+    
+    for (int k = 0; k < bins; k++)
+    {
+        sdft->rotate_re[k] = cos(2.0 * POD_SDFT_PI * k / size);
+        sdft->rotate_im[k] = sin(2.0 * POD_SDFT_PI * k / size);
+    }
+    
+    return sdft;
+}
+
+void pod_sdft_destroy(t_pod_sdft* sdft)
+{
+    if (sdft == NULL)
+        return;
+    
+    free(sdft->re);
+    free(sdft->im);
+    free(sdft->rotate_re);
+    free(sdft->rotate_im);
+    free(sdft);
+}
+
+void pod_sdft_load(t_pod_sdft* sdft, int channel, const float* spectrum)
+{
+    double* re = sdft->re + channel * sdft->bins;
+    double* im = sdft->im + channel * sdft->bins;
+    
+    for (int k = 0; k < sdft->bins; k++)
+    {
+        re[k] = spectrum[2 * k];
+        im[k] = spectrum[2 * k + 1];
+    }
+}
+
+void pod_sdft_update(t_pod_sdft* sdft, const float* history, int history_size, int start, int n)
+{
+    int mask = history_size - 1;
+    int channels = sdft->channels;
+    int bins = sdft->bins;
+    const double* rotate_re = sdft->rotate_re;
+    const double* rotate_im = sdft->rotate_im;
+    
+    // One channel at a time so its bins stay in cache for the whole run; the bins are independent of each
+    // other, so the inner loop vectorizes
+    for (int c = 0; c < channels; c++)
+    {
+        double* re = sdft->re + c * bins;
+        double* im = sdft->im + c * bins;
+        
+        for (int j = 0; j < n; j++)
+        {
+            int now = (start + j) & mask;
+            int leaving = (start + j - sdft->size) & mask;
+            double delta = (double)history[now * channels + c] - history[leaving * channels + c];
+            
+            for (int k = 0; k < bins; k++)
+            {
+                double r = re[k] + delta;
+                double i = im[k];
+                
+                re[k] = r * rotate_re[k] - i * rotate_im[k];
+                im[k] = r * rotate_im[k] + i * rotate_re[k];
+            }
+        }
+    }
+}
+
+void pod_sdft_magnitudes(const t_pod_sdft* sdft, int channel, float a0, float a1, float* out, int stride, int power)
+{
+    const double* re = sdft->re + channel * sdft->bins;
+    const double* im = sdft->im + channel * sdft->bins;
+    double scale = 1.0 / sdft->size;
+    
+    out[0] = 0.0;
+    for (int k = 1; k < sdft->bins - 1; k++)
+    {
+        double r = a0 * re[k] - a1 * (re[k - 1] + re[k + 1]);
+        double i = a0 * im[k] - a1 * (im[k - 1] + im[k + 1]);
+        
+        out[k * stride] = power ? scale * scale * (r * r + i * i) : scale * sqrt(r * r + i * i);
+    }
+}
@@ -0,0 +1,54 @@
+//
+//  pod_sdft.h
+//  pod
+//
+//
+// Copyright (C) 2012 Scott McCoid, Gregoire Tronel, Jay Clark
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy of this software
+// and associated documentation files (the "Software"), to deal in the Software without restriction,
+// including without limitation the rights to use, copy, modify, merge, publish, distribute, sublicense,
+// and/or sell copies of the Software, and to permit persons to whom the Software is furnished to do so,
+// subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in all copies or substantial
+// portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR IMPLIED, INCLUDING BUT NOT
+// LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.
+// IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY,
+// WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE
+// SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+
+
+// Sliding DFT: a handful of bins of the spectrum of the latest size samples, updated one sample at a time
+// instead of transforming the whole window every hop. Each step is
+//      X(k) <- (X(k) - x(t - size) + x(t)) * e^(j 2 pi k / size)
+// for every tracked bin, so the cost is the number of bins per sample whatever the hop.
+//
+// The recursion has no damping, so rounding slowly builds up; callers reload the bins from a real fft of the
+// same samples every so often. The state is kept in double to make that rare.
+
+#ifndef POD_SDFT_H
+#define POD_SDFT_H
+
+typedef struct _pod_sdft t_pod_sdft;
+
+// Tracks bins 0 .. bins - 1 of a size point spectrum for each of channels inputs. All zero to start with.
+t_pod_sdft* pod_sdft_create(int size, int bins, int channels);
+void pod_sdft_destroy(t_pod_sdft* sdft);
+
+// Replaces one channel's bins with those of an unscaled forward fft of its latest size samples, as
+// interleaved (re, im) pairs
+void pod_sdft_load(t_pod_sdft* sdft, int channel, const float* spectrum);
+
+// Slides every channel on by the n frames starting at start in history, a circular buffer of history_size
+// frames (a power of two, at least size + n) with channels interleaved. The frames leaving are size earlier.
+void pod_sdft_update(t_pod_sdft* sdft, const float* history, int history_size, int start, int n);
+
+// Magnitudes of bins 1 .. bins - 2 under a raised cosine window a0 - 2 a1 cos(2 pi i / size), applied as
+// a0 X(k) - a1 (X(k - 1) + X(k + 1)) and scaled by 1 / size, or their squares when power is set.
+// out[k * stride] gets bin k; bin 0 gets zero.
+void pod_sdft_magnitudes(const t_pod_sdft* sdft, int channel, float a0, float a1, float* out, int stride, int power);
+
+#endif
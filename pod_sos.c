@@ -0,0 +1,556 @@
+//
+//  pod_sos.c
+//  pod
+//
+//
+// Copyright (C) 2012 Scott McCoid, Gregoire Tronel, Jay Clark
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy of this software
+// and associated documentation files (the "Software"), to deal in the Software without restriction,
+// including without limitation the rights to use, copy, modify, merge, publish, distribute, sublicense,
+// and/or sell copies of the Software, and to permit persons to whom the Software is furnished to do so,
+// subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in all copies or substantial
+// portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR IMPLIED, INCLUDING BUT NOT
+// LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.
+// IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY,
+// WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE
+// SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+
+
+#include "pod_sos.h"
+#include <string.h>
+
+#if defined(POD_CPU_X86)
+#include <immintrin.h>
+#endif
+#if defined(POD_CPU_NEON)
+#include <arm_neon.h>
+#endif
+
+typedef void (*t_section_kernel)(t_pod_sos_section* s, const float* in, float* out, int n);
+
+static t_pod_isa sos_isa = POD_ISA_SCALAR;      // see pod_sos_use
+
+#pragma mark - Setup -
+
+void pod_sos_init(t_pod_sos* f)
+{
+    memset(f, 0, sizeof(t_pod_sos));
+}
+
+static void compute_block_terms(t_pod_sos_section* s)
+{
+    // Run the recursion once per term with that term set to one and everything else zero.
+    // The outputs are the term's contribution to each sample of a run.
+    for (int term = 0; term < POD_SOS_NUM_TERMS; term++)
+    {
+        double x1 = (term == 0), x2 = (term == 1), y1 = (term == 2), y2 = (term == 3);
+        
+        for (int k = 0; k < POD_SOS_MAX_LANES; k++)
+        {
+            double x0 = (term - 4 == k);
+            double y0 = s->b0 * x0 + s->b1 * x1 + s->b2 * x2 - s->a1 * y1 - s->a2 * y2;
+            
+            s->block[term][k] = y0;
+            x2 = x1;
+            x1 = x0;
+            y2 = y1;
+            y1 = y0;
+        }
+    }
+}
+
+int pod_sos_add_section(t_pod_sos* f, float b0, float b1, float b2, float a1, float a2)
+{
+    if (f->num_sections == POD_SOS_MAX_SECTIONS)
+        return -1;
+    
+    t_pod_sos_section* s = &f->section[f->num_sections++];
+    
+    s->b0 = b0;
+    s->b1 = b1;
+    s->b2 = b2;
+    s->a1 = a1;
+    s->a2 = a2;
+    s->x1 = s->x2 = s->y1 = s->y2 = 0.0;
+    compute_block_terms(s);
+    
+    return 0;
+}
+
+void pod_sos_reset(t_pod_sos* f)
+{
+    for (int i = 0; i < f->num_sections; i++)
+        f->section[i].x1 = f->section[i].x2 = f->section[i].y1 = f->section[i].y2 = 0.0;
+}
+
+#pragma mark - Kernels -
+
+// Each kernel runs one section over a block with the state held in locals, and finishes any samples that
+// don't fill a whole run one at a time.
+
+#define SOS_SCALAR_TAIL(s, in, out, i, n, x1, x2, y1, y2)                                                \
+    for (; i < n; i++)                                                                                  \
+    {                                                                                                   \
+        float x0 = in[i];                                                                               \
+        float y0 = s->b0 * x0 + s->b1 * x1 + s->b2 * x2 - s->a1 * y1 - s->a2 * y2;                      \
+        x2 = x1;                                                                                        \
+        x1 = x0;                                                                                        \
+        y2 = y1;                                                                                        \
+        y1 = y0;                                                                                        \
+        out[i] = y0;                                                                                    \
+    }
+
+static void section_scalar(t_pod_sos_section* s, const float* in, float* out, int n)
+{
+    float x1 = s->x1, x2 = s->x2, y1 = s->y1, y2 = s->y2;
+    int i = 0;
+    
+    SOS_SCALAR_TAIL(s, in, out, i, n, x1, x2, y1, y2);
+    
+    s->x1 = x1;
+    s->x2 = x2;
+    s->y1 = y1;
+    s->y2 = y2;
+}
+
+#if defined(POD_CPU_X86)
+POD_TARGET("sse2") static void section_sse(t_pod_sos_section* s, const float* in, float* out, int n)
+{
+    float x1 = s->x1, x2 = s->x2, y1 = s->y1, y2 = s->y2;
+    __m128 c_x1 = _mm_loadu_ps(s->block[0]);
+    __m128 c_x2 = _mm_loadu_ps(s->block[1]);
+    __m128 c_y1 = _mm_loadu_ps(s->block[2]);
+    __m128 c_y2 = _mm_loadu_ps(s->block[3]);
+    __m128 c_0 = _mm_loadu_ps(s->block[4]);
+    __m128 c_1 = _mm_loadu_ps(s->block[5]);
+    __m128 c_2 = _mm_loadu_ps(s->block[6]);
+    __m128 c_3 = _mm_loadu_ps(s->block[7]);
+    int i = 0;
+    
+    for (; i + 4 <= n; i += 4)
+    {
+        float in0 = in[i], in1 = in[i + 1], in2 = in[i + 2], in3 = in[i + 3];
+        
+        __m128 acc = _mm_mul_ps(c_x1, _mm_set1_ps(x1));
+        acc = _mm_add_ps(acc, _mm_mul_ps(c_x2, _mm_set1_ps(x2)));
+        acc = _mm_add_ps(acc, _mm_mul_ps(c_y1, _mm_set1_ps(y1)));
+        acc = _mm_add_ps(acc, _mm_mul_ps(c_y2, _mm_set1_ps(y2)));
+        acc = _mm_add_ps(acc, _mm_mul_ps(c_0, _mm_set1_ps(in0)));
+        acc = _mm_add_ps(acc, _mm_mul_ps(c_1, _mm_set1_ps(in1)));
+        acc = _mm_add_ps(acc, _mm_mul_ps(c_2, _mm_set1_ps(in2)));
+        acc = _mm_add_ps(acc, _mm_mul_ps(c_3, _mm_set1_ps(in3)));
+        _mm_storeu_ps(out + i, acc);
+        
+        x2 = in2;
+        x1 = in3;
+        y2 = out[i + 2];
+        y1 = out[i + 3];
+    }
+    
+    SOS_SCALAR_TAIL(s, in, out, i, n, x1, x2, y1, y2);
+    
+    s->x1 = x1;
+    s->x2 = x2;
+    s->y1 = y1;
+    s->y2 = y2;
+}
+#endif
+
+#if defined(POD_CPU_X86)
+POD_TARGET("avx") static void section_avx(t_pod_sos_section* s, const float* in, float* out, int n)
+{
+    float x1 = s->x1, x2 = s->x2, y1 = s->y1, y2 = s->y2;
+    __m256 c[POD_SOS_NUM_TERMS];
+    int i = 0;
+    
+    for (int t = 0; t < POD_SOS_NUM_TERMS; t++)
+        c[t] = _mm256_loadu_ps(s->block[t]);
+    
+    for (; i + 8 <= n; i += 8)
+    {
+        float run[8];
+        memcpy(run, in + i, sizeof(run));
+        
+        __m256 acc = _mm256_mul_ps(c[0], _mm256_set1_ps(x1));
+        acc = _mm256_add_ps(acc, _mm256_mul_ps(c[1], _mm256_set1_ps(x2)));
+        acc = _mm256_add_ps(acc, _mm256_mul_ps(c[2], _mm256_set1_ps(y1)));
+        acc = _mm256_add_ps(acc, _mm256_mul_ps(c[3], _mm256_set1_ps(y2)));
+        for (int k = 0; k < 8; k++)
+            acc = _mm256_add_ps(acc, _mm256_mul_ps(c[4 + k], _mm256_set1_ps(run[k])));
+        _mm256_storeu_ps(out + i, acc);
+        
+        x2 = run[6];
+        x1 = run[7];
+        y2 = out[i + 6];
+        y1 = out[i + 7];
+    }
+    
+    SOS_SCALAR_TAIL(s, in, out, i, n, x1, x2, y1, y2);
+    
+    s->x1 = x1;
+    s->x2 = x2;
+    s->y1 = y1;
+    s->y2 = y2;
+}
+#endif
+
+#if defined(POD_CPU_NEON)
+static void section_neon(t_pod_sos_section* s, const float* in, float* out, int n)
+{
+    float x1 = s->x1, x2 = s->x2, y1 = s->y1, y2 = s->y2;
+    float32x4_t c_x1 = vld1q_f32(s->block[0]);
+    float32x4_t c_x2 = vld1q_f32(s->block[1]);
+    float32x4_t c_y1 = vld1q_f32(s->block[2]);
+    float32x4_t c_y2 = vld1q_f32(s->block[3]);
+    float32x4_t c_0 = vld1q_f32(s->block[4]);
+    float32x4_t c_1 = vld1q_f32(s->block[5]);
+    float32x4_t c_2 = vld1q_f32(s->block[6]);
+    float32x4_t c_3 = vld1q_f32(s->block[7]);
+    int i = 0;
+    
+    for (; i + 4 <= n; i += 4)
+    {
+        float in0 = in[i], in1 = in[i + 1], in2 = in[i + 2], in3 = in[i + 3];
+        
+        float32x4_t acc = vmulq_n_f32(c_x1, x1);
+        acc = vmlaq_n_f32(acc, c_x2, x2);
+        acc = vmlaq_n_f32(acc, c_y1, y1);
+        acc = vmlaq_n_f32(acc, c_y2, y2);
+        acc = vmlaq_n_f32(acc, c_0, in0);
+        acc = vmlaq_n_f32(acc, c_1, in1);
+        acc = vmlaq_n_f32(acc, c_2, in2);
+        acc = vmlaq_n_f32(acc, c_3, in3);
+        vst1q_f32(out + i, acc);
+        
+        x2 = in2;
+        x1 = in3;
+        y2 = vgetq_lane_f32(acc, 2);
+        y1 = vgetq_lane_f32(acc, 3);
+    }
+    
+    SOS_SCALAR_TAIL(s, in, out, i, n, x1, x2, y1, y2);
+    
+    s->x1 = x1;
+    s->x2 = x2;
+    s->y1 = y1;
+    s->y2 = y2;
+}
+#endif
+
+#pragma mark - Channel Kernels -
+
+// state rows for section s: x1, x2, y1, y2, each channels long
+#define SOS_ROW(state, channels, s, row) ((state) + ((s) * 4 + (row)) * (channels))
+
+static void channels_scalar(const t_pod_sos* f, float* state, int channels, int first,
+                            const float* const* in, int offset, float* out, int n)
+{
+    for (int c = first; c < channels; c++)
+    {
+        const float* src = in[c] + offset;
+        float x1[POD_SOS_MAX_SECTIONS], x2[POD_SOS_MAX_SECTIONS], y1[POD_SOS_MAX_SECTIONS], y2[POD_SOS_MAX_SECTIONS];
+        
+        for (int s = 0; s < f->num_sections; s++)
+        {
+            x1[s] = SOS_ROW(state, channels, s, 0)[c];
+            x2[s] = SOS_ROW(state, channels, s, 1)[c];
+            y1[s] = SOS_ROW(state, channels, s, 2)[c];
+            y2[s] = SOS_ROW(state, channels, s, 3)[c];
+        }
+        
+        for (int i = 0; i < n; i++)
+        {
+            float v = src[i];
+            
+            for (int s = 0; s < f->num_sections; s++)
+            {
+                const t_pod_sos_section* k = &f->section[s];
+                float y0 = k->b0 * v + k->b1 * x1[s] + k->b2 * x2[s] - k->a1 * y1[s] - k->a2 * y2[s];
+                x2[s] = x1[s];
+                x1[s] = v;
+                y2[s] = y1[s];
+                y1[s] = y0;
+                v = y0;
+            }
+            
+            out[i * channels + c] = v;
+        }
+        
+        for (int s = 0; s < f->num_sections; s++)
+        {
+            SOS_ROW(state, channels, s, 0)[c] = x1[s];
+            SOS_ROW(state, channels, s, 1)[c] = x2[s];
+            SOS_ROW(state, channels, s, 2)[c] = y1[s];
+            SOS_ROW(state, channels, s, 3)[c] = y2[s];
+        }
+    }
+}
+
+#if defined(POD_CPU_X86)
+POD_TARGET("avx") static int channels_avx(const t_pod_sos* f, float* state, int channels, int first,
+                                          const float* const* in, int offset, float* out, int n)
+{
+    int c = first;
+    
+    for (; c + 8 <= channels; c += 8)
+    {
+        __m256 x1[POD_SOS_MAX_SECTIONS], x2[POD_SOS_MAX_SECTIONS], y1[POD_SOS_MAX_SECTIONS], y2[POD_SOS_MAX_SECTIONS];
+        
+        for (int s = 0; s < f->num_sections; s++)
+        {
+            x1[s] = _mm256_loadu_ps(SOS_ROW(state, channels, s, 0) + c);
+            x2[s] = _mm256_loadu_ps(SOS_ROW(state, channels, s, 1) + c);
+            y1[s] = _mm256_loadu_ps(SOS_ROW(state, channels, s, 2) + c);
+            y2[s] = _mm256_loadu_ps(SOS_ROW(state, channels, s, 3) + c);
+        }
+        
+        for (int i = 0; i < n; i++)
+        {
+            float lanes[8];
+            
+            for (int k = 0; k < 8; k++)
+                lanes[k] = in[c + k][offset + i];
+                
+            __m256 v = _mm256_loadu_ps(lanes);
+            
+            for (int s = 0; s < f->num_sections; s++)
+            {
+                const t_pod_sos_section* k = &f->section[s];
+                __m256 y0 = _mm256_mul_ps(_mm256_set1_ps(k->b0), v);
+                y0 = _mm256_add_ps(y0, _mm256_mul_ps(_mm256_set1_ps(k->b1), x1[s]));
+                y0 = _mm256_add_ps(y0, _mm256_mul_ps(_mm256_set1_ps(k->b2), x2[s]));
+                y0 = _mm256_sub_ps(y0, _mm256_mul_ps(_mm256_set1_ps(k->a1), y1[s]));
+                y0 = _mm256_sub_ps(y0, _mm256_mul_ps(_mm256_set1_ps(k->a2), y2[s]));
+                x2[s] = x1[s];
+                x1[s] = v;
+                y2[s] = y1[s];
+                y1[s] = y0;
+                v = y0;
+            }
+            
+            _mm256_storeu_ps(out + i * channels + c, v);
+        }
+        
+        for (int s = 0; s < f->num_sections; s++)
+        {
+            _mm256_storeu_ps(SOS_ROW(state, channels, s, 0) + c, x1[s]);
+            _mm256_storeu_ps(SOS_ROW(state, channels, s, 1) + c, x2[s]);
+            _mm256_storeu_ps(SOS_ROW(state, channels, s, 2) + c, y1[s]);
+            _mm256_storeu_ps(SOS_ROW(state, channels, s, 3) + c, y2[s]);
+        }
+    }
+    
+    return c;
+}
+
+POD_TARGET("sse2") static int channels_sse(const t_pod_sos* f, float* state, int channels, int first,
+                                           const float* const* in, int offset, float* out, int n)
+{
+    int c = first;
+    
+    for (; c + 4 <= channels; c += 4)
+    {
+        const float* p0 = in[c] + offset;
+        const float* p1 = in[c + 1] + offset;
+        const float* p2 = in[c + 2] + offset;
+        const float* p3 = in[c + 3] + offset;
+        __m128 x1[POD_SOS_MAX_SECTIONS], x2[POD_SOS_MAX_SECTIONS], y1[POD_SOS_MAX_SECTIONS], y2[POD_SOS_MAX_SECTIONS];
+        
+        for (int s = 0; s < f->num_sections; s++)
+        {
+            x1[s] = _mm_loadu_ps(SOS_ROW(state, channels, s, 0) + c);
+            x2[s] = _mm_loadu_ps(SOS_ROW(state, channels, s, 1) + c);
+            y1[s] = _mm_loadu_ps(SOS_ROW(state, channels, s, 2) + c);
+            y2[s] = _mm_loadu_ps(SOS_ROW(state, channels, s, 3) + c);
+        }
+        
+        for (int i = 0; i < n; i++)
+        {
+            __m128 v = _mm_setr_ps(p0[i], p1[i], p2[i], p3[i]);
+            
+            for (int s = 0; s < f->num_sections; s++)
+            {
+                const t_pod_sos_section* k = &f->section[s];
+                __m128 y0 = _mm_mul_ps(_mm_set1_ps(k->b0), v);
+                y0 = _mm_add_ps(y0, _mm_mul_ps(_mm_set1_ps(k->b1), x1[s]));
+                y0 = _mm_add_ps(y0, _mm_mul_ps(_mm_set1_ps(k->b2), x2[s]));
+                y0 = _mm_sub_ps(y0, _mm_mul_ps(_mm_set1_ps(k->a1), y1[s]));
+                y0 = _mm_sub_ps(y0, _mm_mul_ps(_mm_set1_ps(k->a2), y2[s]));
+                x2[s] = x1[s];
+                x1[s] = v;
+                y2[s] = y1[s];
+                y1[s] = y0;
+                v = y0;
+            }
+            
+            _mm_storeu_ps(out + i * channels + c, v);
+        }
+        
+        for (int s = 0; s < f->num_sections; s++)
+        {
+            _mm_storeu_ps(SOS_ROW(state, channels, s, 0) + c, x1[s]);
+            _mm_storeu_ps(SOS_ROW(state, channels, s, 1) + c, x2[s]);
+            _mm_storeu_ps(SOS_ROW(state, channels, s, 2) + c, y1[s]);
+            _mm_storeu_ps(SOS_ROW(state, channels, s, 3) + c, y2[s]);
+        }
+    }
+    
+    return c;
+}
+#endif
+
+#if defined(POD_CPU_NEON)
+static int channels_neon(const t_pod_sos* f, float* state, int channels, int first,
+                         const float* const* in, int offset, float* out, int n)
+{
+    int c = first;
+    
+    for (; c + 4 <= channels; c += 4)
+    {
+        const float* p0 = in[c] + offset;
+        const float* p1 = in[c + 1] + offset;
+        const float* p2 = in[c + 2] + offset;
+        const float* p3 = in[c + 3] + offset;
+        float32x4_t x1[POD_SOS_MAX_SECTIONS], x2[POD_SOS_MAX_SECTIONS], y1[POD_SOS_MAX_SECTIONS], y2[POD_SOS_MAX_SECTIONS];
+        
+        for (int s = 0; s < f->num_sections; s++)
+        {
+            x1[s] = vld1q_f32(SOS_ROW(state, channels, s, 0) + c);
+            x2[s] = vld1q_f32(SOS_ROW(state, channels, s, 1) + c);
+            y1[s] = vld1q_f32(SOS_ROW(state, channels, s, 2) + c);
+            y2[s] = vld1q_f32(SOS_ROW(state, channels, s, 3) + c);
+        }
+        
+        for (int i = 0; i < n; i++)
+        {
+            float lanes[4] = { p0[i], p1[i], p2[i], p3[i] };
+            float32x4_t v = vld1q_f32(lanes);
+            
+            for (int s = 0; s < f->num_sections; s++)
+            {
+                const t_pod_sos_section* k = &f->section[s];
+                float32x4_t y0 = vmulq_n_f32(v, k->b0);
+                y0 = vmlaq_n_f32(y0, x1[s], k->b1);
+                y0 = vmlaq_n_f32(y0, x2[s], k->b2);
+                y0 = vmlsq_n_f32(y0, y1[s], k->a1);
+                y0 = vmlsq_n_f32(y0, y2[s], k->a2);
+                x2[s] = x1[s];
+                x1[s] = v;
+                y2[s] = y1[s];
+                y1[s] = y0;
+                v = y0;
+            }
+            
+            vst1q_f32(out + i * channels + c, v);
+        }
+        
+        for (int s = 0; s < f->num_sections; s++)
+        {
+            vst1q_f32(SOS_ROW(state, channels, s, 0) + c, x1[s]);
+            vst1q_f32(SOS_ROW(state, channels, s, 1) + c, x2[s]);
+            vst1q_f32(SOS_ROW(state, channels, s, 2) + c, y1[s]);
+            vst1q_f32(SOS_ROW(state, channels, s, 3) + c, y2[s]);
+        }
+    }
+    
+    return c;
+}
+#endif
+
+int pod_sos_channel_state_size(const t_pod_sos* f, int channels)
+{
+    return f->num_sections * 4 * channels;
+}
+
+void pod_sos_process_channels(const t_pod_sos* f, float* state, int channels,
+                              const float* const* in, int offset, float* out, int n)
+{
+    pod_sos_process_channels_isa(f, state, channels, in, offset, out, n, sos_isa);
+}
+
+void pod_sos_process_channels_isa(const t_pod_sos* f, float* state, int channels,
+                                  const float* const* in, int offset, float* out, int n, t_pod_isa isa)
+{
+    int done = 0;
+    
+    // Whole groups of eight (AVX) or four channels go through the vector kernels, the rest one at a time
+    switch (isa)
+    {
+#if defined(POD_CPU_X86)
+        case POD_ISA_AVX2:
+        case POD_ISA_AVX512:
+            done = channels_avx(f, state, channels, done, in, offset, out, n);
+            done = channels_sse(f, state, channels, done, in, offset, out, n);
+            break;
+            
+        case POD_ISA_SSE2:
+            done = channels_sse(f, state, channels, done, in, offset, out, n);
+            break;
+#endif
+#if defined(POD_CPU_NEON)
+        case POD_ISA_NEON:
+            done = channels_neon(f, state, channels, done, in, offset, out, n);
+            break;
+#endif
+        default:
+            break;
+    }
+    
+    channels_scalar(f, state, channels, done, in, offset, out, n);
+}
+
+#pragma mark - Cascade -
+
+static t_section_kernel section_kernel(t_pod_isa isa)
+{
+    // The block matrix is at most eight lanes wide, so AVX-512 runs the AVX kernel
+    switch (isa)
+    {
+#if defined(POD_CPU_X86)
+        case POD_ISA_SSE2:
+            return section_sse;
+            
+        case POD_ISA_AVX2:
+        case POD_ISA_AVX512:
+            return section_avx;
+#endif
+#if defined(POD_CPU_NEON)
+        case POD_ISA_NEON:
+            return section_neon;
+#endif
+        default:
+            return section_scalar;
+    }
+}
+
+void pod_sos_use(t_pod_isa isa)
+{
+    sos_isa = pod_cpu_supports(isa) ? isa : POD_ISA_SCALAR;
+}
+
+void pod_sos_process(t_pod_sos* f, const float* in, float* out, int n)
+{
+    pod_sos_process_isa(f, in, out, n, sos_isa);
+}
+
+void pod_sos_process_isa(t_pod_sos* f, const float* in, float* out, int n, t_pod_isa isa)
+{
+    t_section_kernel kernel = section_kernel(isa);
+    
+    if (f->num_sections == 0 && in != out)
+        memmove(out, in, n * sizeof(float));
+        
+    // The first section reads the input, every later one works in place on the output
+    for (int i = 0; i < f->num_sections; i++)
+        kernel(&f->section[i], (i == 0) ? in : out, out, n);
+}
+
+void pod_sos_process_scalar(t_pod_sos* f, const float* in, float* out, int n)
+{
+    pod_sos_process_isa(f, in, out, n, POD_ISA_SCALAR);
+}
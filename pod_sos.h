@@ -0,0 +1,86 @@
+//
+//  pod_sos.h
+//  pod
+//
+//
+// Copyright (C) 2012 Scott McCoid, Gregoire Tronel, Jay Clark
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy of this software
+// and associated documentation files (the "Software"), to deal in the Software without restriction,
+// including without limitation the rights to use, copy, modify, merge, publish, distribute, sublicense,
+// and/or sell copies of the Software, and to permit persons to whom the Software is furnished to do so,
+// subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in all copies or substantial
+// portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR IMPLIED, INCLUDING BUT NOT
+// LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.
+// IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY,
+// WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE
+// SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+
+
+// Cascaded second-order sections, processed a block at a time.
+//
+// Each section is a direct form I biquad:
+//      y(n) = b0*x(n) + b1*x(n-1) + b2*x(n-2) - a1*y(n-1) - a2*y(n-2)
+//
+// The vector kernels compute four (SSE2, NEON) or eight (AVX) outputs at once. For a run of L samples every output is a linear
+// combination of the L inputs and the four state values, so each section keeps a small matrix of those
+// combinations (its impulse responses) and the recursion turns into L-wide multiply-adds.
+
+#ifndef POD_SOS_H
+#define POD_SOS_H
+
+#include "pod_cpu.h"
+
+#define POD_SOS_MAX_SECTIONS 4
+#define POD_SOS_MAX_LANES 8
+#define POD_SOS_NUM_TERMS (4 + POD_SOS_MAX_LANES)   // x1, x2, y1, y2, then one term per input in the run
+
+typedef struct _pod_sos_section
+{
+    float       b0, b1, b2, a1, a2;
+    float       x1, x2, y1, y2;                 // state
+    
+    // block[term][k] is the weight of term in output k of a run
+    float       block[POD_SOS_NUM_TERMS][POD_SOS_MAX_LANES];
+    
+} t_pod_sos_section;
+
+typedef struct _pod_sos
+{
+    t_pod_sos_section   section[POD_SOS_MAX_SECTIONS];
+    int                 num_sections;
+    
+} t_pod_sos;
+
+void pod_sos_init(t_pod_sos* f);
+int pod_sos_add_section(t_pod_sos* f, float b0, float b1, float b2, float a1, float a2);
+void pod_sos_reset(t_pod_sos* f);
+
+// Picks the kernels pod_sos_process and pod_sos_process_channels run from now on, for every filter. An isa
+// the processor lacks picks the scalar ones. Main thread, between blocks.
+void pod_sos_use(t_pod_isa isa);
+
+// Runs the cascade over n samples. in and out may be the same buffer; neither needs to be aligned.
+void pod_sos_process(t_pod_sos* f, const float* in, float* out, int n);
+
+// The same with isa's kernels whatever pod_sos_use picked, for checking them. isa must be supported.
+void pod_sos_process_isa(t_pod_sos* f, const float* in, float* out, int n, t_pod_isa isa);
+
+// Sample-at-a-time reference the vector kernels are checked against
+void pod_sos_process_scalar(t_pod_sos* f, const float* in, float* out, int n);
+
+// Runs f's coefficients over several channels at once, one channel per vector lane. The state lives outside
+// f, in pod_sos_channel_state_size(f, channels) floats laid out as structure of arrays: for each section a
+// row of x1, x2, y1 and y2 with one entry per channel. Input n samples start at in[channel] + offset; output
+// is interleaved, n frames of channels samples.
+int pod_sos_channel_state_size(const t_pod_sos* f, int channels);
+void pod_sos_process_channels(const t_pod_sos* f, float* state, int channels,
+                              const float* const* in, int offset, float* out, int n);
+void pod_sos_process_channels_isa(const t_pod_sos* f, float* state, int channels,
+                                  const float* const* in, int offset, float* out, int n, t_pod_isa isa);
+
+#endif
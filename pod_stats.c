@@ -0,0 +1,309 @@
+//
+//  pod_stats.c
+//  pod
+//
+//
+// Copyright (C) 2012 Scott McCoid, Gregoire Tronel, Jay Clark
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy of this software
+// and associated documentation files (the "Software"), to deal in the Software without restriction,
+// including without limitation the rights to use, copy, modify, merge, publish, distribute, sublicense,
+// and/or sell copies of the Software, and to permit persons to whom the Software is furnished to do so,
+// subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in all copies or substantial
+// portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR IMPLIED, INCLUDING BUT NOT
+// LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.
+// IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY,
+// WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE
+// SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+
+
+#include "pod_stats.h"
+#include <stdlib.h>
+
+struct _pod_stats
+{
+    int         capacity;                       // values in the window, 0 for no window
+    int         count;
+    int         oldest;                         // slot the next value goes in once the window is full
+    float*      values;                         // the window as a ring
+    
+    // running sums; recomputed from the window every capacity values so rounding cannot build up
+    double      sum, sum_squares;
+    int         since_recompute;
+    float       mean;                           // without a window, in the same form the old average used
+    double      variance_sum;                   // and Welford's sum of squared differences
+    
+    // Slots split at the percentile's rank: low is a max heap of the smallest values, high a min heap of
+    // the rest. place[slot] is 1 + the slot's position in low, or -(1 + its position in high).
+    float       percentile;
+    int*        low;
+    int*        high;
+    int         num_low, num_high;
+    int*        place;
+};
+
+static void heap_remove(t_pod_stats* s, int slot);
+static void heap_insert(t_pod_stats* s, int slot);
+static void rebalance(t_pod_stats* s);
+static void sift_up(t_pod_stats* s, int* heap, int low, int position);
+static void sift_down(t_pod_stats* s, int* heap, int size, int low, int position);
+static void recompute(t_pod_stats* s);
+
+t_pod_stats* pod_stats_create(int capacity, float percentile)
+{
+    t_pod_stats* s = (t_pod_stats *)calloc(1, sizeof(t_pod_stats));
+    
+    if (s == NULL)
+        return NULL;
+    
+    s->capacity = capacity > 0 ? capacity : 0;
+    s->percentile = percentile;
+    
+    if (s->capacity > 0)
+    {
+        s->values = (float *)calloc(s->capacity, sizeof(float));
+        s->low = (int *)calloc(s->capacity, sizeof(int));
+        s->high = (int *)calloc(s->capacity, sizeof(int));
+        s->place = (int *)calloc(s->capacity, sizeof(int));
+        
+        if (s->values == NULL || s->low == NULL || s->high == NULL || s->place == NULL)
+        {
+            pod_stats_destroy(s);
+            return NULL;
+        }
+    }
+    
+    return s;
+}
+
+void pod_stats_destroy(t_pod_stats* s)
+{
+    if (s == NULL)
+        return;
+    
+    free(s->values);
+    free(s->low);
+    free(s->high);
+    free(s->place);
+    free(s);
+}
+
+void pod_stats_clear(t_pod_stats* s)
+{
+    s->count = 0;
+    s->oldest = 0;
+    s->sum = s->sum_squares = 0.0;
+    s->since_recompute = 0;
+    s->mean = 0.0;
+    s->variance_sum = 0.0;
+    s->num_low = s->num_high = 0;
+}
+
+void pod_stats_add(t_pod_stats* s, float value)
+{
+    int slot;
+    
+    if (s->capacity == 0)
+    {
+        float previous = s->mean;
+        
+        s->mean = (s->mean * s->count + value) / (s->count + 1);
+        s->count++;
+        s->variance_sum += (value - previous) * (value - s->mean);
+        return;
+    }
+    
+    // a full window drops its oldest value to make room
+    if (s->count == s->capacity)
+    {
+        slot = s->oldest;
+        s->oldest = (s->oldest + 1) % s->capacity;
+        
+        heap_remove(s, slot);
+        s->sum -= s->values[slot];
+        s->sum_squares -= (double)s->values[slot] * s->values[slot];
+    }
+    else
+        slot = (s->oldest + s->count++) % s->capacity;
+    
+    s->values[slot] = value;
+    s->sum += value;
+    s->sum_squares += (double)value * value;
+    
+    heap_insert(s, slot);
+    rebalance(s);
+    
+    if (++s->since_recompute >= s->capacity)
+        recompute(s);
+}
+
+int pod_stats_count(const t_pod_stats* s)
+{
+    return s->count;
+}
+
+float pod_stats_mean(const t_pod_stats* s)
+{
+    if (s->capacity == 0)
+        return s->mean;
+    
+    return s->count > 0 ? s->sum / s->count : 0.0;
+}
+
+float pod_stats_variance(const t_pod_stats* s)
+{
+    double mean, variance;
+    
+    if (s->count == 0)
+        return 0.0;
+    
+    if (s->capacity == 0)
+        return s->variance_sum / s->count;
+    
+    mean = s->sum / s->count;
+    variance = s->sum_squares / s->count - mean * mean;
+    return variance > 0.0 ? variance : 0.0;
+}
+
+float pod_stats_percentile(const t_pod_stats* s)
+{
+    if (s->capacity == 0)
+        return s->mean;
+    
+    return s->num_low > 0 ? s->values[s->low[0]] : 0.0;
+}
+
+void pod_stats_set_percentile(t_pod_stats* s, float percentile)
+{
+    s->percentile = percentile;
+    
+    if (s->capacity > 0)
+        rebalance(s);
+}
+
+#pragma mark - Heaps -
+
+static int above(const t_pod_stats* s, int low, int a, int b)
+{
+    // whether slot a belongs nearer the top than slot b
+    return low ? s->values[a] > s->values[b] : s->values[a] < s->values[b];
+}
+
+static void set(t_pod_stats* s, int* heap, int low, int position, int slot)
+{
+    heap[position] = slot;
+    s->place[slot] = low ? position + 1 : -(position + 1);
+}
+
+static void sift_up(t_pod_stats* s, int* heap, int low, int position)
+{
+    int slot = heap[position];
+    
+    while (position > 0 && above(s, low, slot, heap[(position - 1) / 2]))
+    {
+        set(s, heap, low, position, heap[(position - 1) / 2]);
+        position = (position - 1) / 2;
+    }
+    
+    set(s, heap, low, position, slot);
+}
+
+static void sift_down(t_pod_stats* s, int* heap, int size, int low, int position)
+{
+    int slot = heap[position];
+    
+    for (;;)
+    {
+        int child = 2 * position + 1;
+        
+        if (child >= size)
+            break;
+        if (child + 1 < size && above(s, low, heap[child + 1], heap[child]))
+            child++;
+        if (! above(s, low, heap[child], slot))
+            break;
+        
+        set(s, heap, low, position, heap[child]);
+        position = child;
+    }
+    
+    set(s, heap, low, position, slot);
+}
+
+static void heap_push(t_pod_stats* s, int low, int slot)
+{
+    int* heap = low ? s->low : s->high;
+    int position = low ? s->num_low++ : s->num_high++;
+    
+    set(s, heap, low, position, slot);
+    sift_up(s, heap, low, position);
+}
+
+static int heap_pop(t_pod_stats* s, int low)
+{
+    int slot = low ? s->low[0] : s->high[0];
+    
+    heap_remove(s, slot);
+    return slot;
+}
+
+static void heap_remove(t_pod_stats* s, int slot)
+{
+    int low = s->place[slot] > 0;
+    int* heap = low ? s->low : s->high;
+    int position = (low ? s->place[slot] : -s->place[slot]) - 1;
+    int last = low ? --s->num_low : --s->num_high;
+    
+    // the last entry fills the hole and moves whichever way it has to
+    if (position != last)
+    {
+        int moved = heap[last];
+        
+        set(s, heap, low, position, moved);
+        sift_up(s, heap, low, position);
+        if (heap[position] == moved)
+            sift_down(s, heap, last, low, position);
+    }
+}
+
+static void heap_insert(t_pod_stats* s, int slot)
+{
+    heap_push(s, s->num_low > 0 && s->values[slot] <= s->values[s->low[0]], slot);
+}
+
+static void rebalance(t_pod_stats* s)
+{
+    // low holds exactly the values up to the percentile's rank
+    int target = 0;
+    
+    if (s->count > 0)
+    {
+        float p = s->percentile < 0.0 ? 0.0 : (s->percentile > 100.0 ? 100.0 : s->percentile);
+        target = (int)(p / 100.0 * (s->count - 1)) + 1;
+    }
+    
+    while (s->num_low > target)
+        heap_push(s, 0, heap_pop(s, 1));
+    
+    while (s->num_low < target && s->num_high > 0)
+        heap_push(s, 1, heap_pop(s, 0));
+}
+
+static void recompute(t_pod_stats* s)
+{
+    s->sum = s->sum_squares = 0.0;
+    
+    for (int i = 0; i < s->count; i++)
+    {
+        float value = s->values[(s->oldest + i) % s->capacity];
+        
+        s->sum += value;
+        s->sum_squares += (double)value * value;
+    }
+    
+    s->since_recompute = 0;
+}
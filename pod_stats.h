@@ -0,0 +1,51 @@
+//
+//  pod_stats.h
+//  pod
+//
+//
+// Copyright (C) 2012 Scott McCoid, Gregoire Tronel, Jay Clark
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy of this software
+// and associated documentation files (the "Software"), to deal in the Software without restriction,
+// including without limitation the rights to use, copy, modify, merge, publish, distribute, sublicense,
+// and/or sell copies of the Software, and to permit persons to whom the Software is furnished to do so,
+// subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in all copies or substantial
+// portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR IMPLIED, INCLUDING BUT NOT
+// LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.
+// IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY,
+// WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE
+// SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+
+
+// Statistics of the most recent values of a stream, for the automatic thresholds: the mean and variance
+// from running sums, and one percentile from a pair of heaps that split the values at that rank. Adding a
+// value, and dropping the one it pushes out of the window, costs O(log n).
+//
+// A capacity of 0 keeps no history: the mean and variance then cover everything added since the last
+// clear, and the percentile is not available.
+
+#ifndef POD_STATS_H
+#define POD_STATS_H
+
+typedef struct _pod_stats t_pod_stats;
+
+t_pod_stats* pod_stats_create(int capacity, float percentile);
+void pod_stats_destroy(t_pod_stats* stats);
+void pod_stats_clear(t_pod_stats* stats);
+
+void pod_stats_add(t_pod_stats* stats, float value);
+
+int pod_stats_count(const t_pod_stats* stats);
+float pod_stats_mean(const t_pod_stats* stats);
+float pod_stats_variance(const t_pod_stats* stats);
+
+// The value at percentile (0 - 100) of the window, rounding down to a value that was added; the mean
+// if there is no window
+float pod_stats_percentile(const t_pod_stats* stats);
+void pod_stats_set_percentile(t_pod_stats* stats, float percentile);
+
+#endif
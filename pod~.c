@@ -21,30 +21,17 @@
 // SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
 
 #include "pod~.h"
-#include <math.h>
+#include "pod_fft.h"
 #include <stdio.h>
 
-#pragma mark - Definitions -
-
-#define BLOCK_SIZE 64
-#define FS 44100.0
-#define PI 3.14159265359
-#define TWO_PI (2 * PI)
-#define NUM_BARKS 24
-#define QUEUE_SIZE 10000
-#define NUM_BARK_FILTER_BUFS 2
-
-// define bark limits and centers
-t_int bark_lim[25] =  { 20, 100, 200, 300, 400, 510, 630, 770, 920, 1080, 1270, 1480, 1720, 2000, 2320, 2700, 3150, 3700, 4400, 5300, 6400, 7700, 9500, 12000, 15500 };
-t_int bark_ctr[26] = {0, 50, 150, 250, 350, 450, 570, 700, 840, 1000, 1170, 1370, 1600, 1850, 2150, 2500, 2900, 3400, 4000, 4800, 5800, 7000, 8500, 10500, 13500, 15500};
-t_float band_weightings[24] = { 0.7762, 0.6854, 0.6647, 0.6373, 0.6255, 0.6170, 0.6139, 0.6107, 0.6127, 0.6329, 0.6380, 0.6430, 0.6151, 0.6033, 0.5914, 0.5843, 0.5895, 0.5947, 0.6237, 0.6703, 0.6920, 0.7137, 0.7217, 0.7217 };
-
-
 #pragma mark - Initialization -
 
 void pod_tilde_setup(void)
 {
-    pod_tilde_class = class_new(gensym("pod~"), (t_newmethod)pod_tilde_new, (t_method)pod_tilde_free, sizeof(t_pod_tilde), CLASS_DEFAULT, A_DEFFLOAT, A_DEFFLOAT, 0);
+    // the kernels for this processor, picked once for every pod~
+    pod_init();
+    
+    pod_tilde_class = class_new(gensym("pod~"), (t_newmethod)pod_tilde_new, (t_method)pod_tilde_free, sizeof(t_pod_tilde), CLASS_DEFAULT, A_DEFFLOAT, A_DEFFLOAT, A_DEFFLOAT, A_DEFFLOAT, 0);
     
     CLASS_MAINSIGNALIN(pod_tilde_class, t_pod_tilde, x_f);
     
@@ -63,6 +50,22 @@ void pod_tilde_setup(void)
         0
             );
     
+    class_addmethod(
+        pod_tilde_class,
+        (t_method)pod_tilde_set_window_size,
+        gensym("windowsize"),
+        A_FLOAT,
+        0
+            );
+    
+    class_addmethod(
+        pod_tilde_class,
+        (t_method)pod_tilde_set_hop_size,
+        gensym("hop"),
+        A_FLOAT,
+        0
+            );
+    
     class_addmethod(
         pod_tilde_class,
         (t_method)pod_tilde_set_debounce_threshold,
@@ -118,630 +121,509 @@ void pod_tilde_setup(void)
         0
             );
     
+    class_addmethod(
+        pod_tilde_class,
+        (t_method)pod_tilde_set_average_window,
+        gensym("average_ms"),
+        A_FLOAT,
+        0
+            );
+    
+    class_addmethod(
+        pod_tilde_class,
+        (t_method)pod_tilde_set_average_percentile,
+        gensym("percentile"),
+        A_FLOAT,
+        0
+            );
+    
+    class_addmethod(
+        pod_tilde_class,
+        (t_method)pod_tilde_average,
+        gensym("average"),
+        0
+            );
+    
+    class_addmethod(
+        pod_tilde_class,
+        (t_method)pod_tilde_profile,
+        gensym("profile"),
+        0
+            );
+    
+    class_addmethod(
+        pod_tilde_class,
+        (t_method)pod_tilde_set_spread,
+        gensym("spread"),
+        A_FLOAT,
+        0
+            );
+    
+    class_addmethod(
+        pod_tilde_class,
+        (t_method)pod_tilde_set_engine,
+        gensym("engine"),
+        A_SYMBOL,
+        0
+            );
+    
+    class_addmethod(
+        pod_tilde_class,
+        (t_method)pod_tilde_check_engine,
+        gensym("check"),
+        0
+            );
+    
+    class_addmethod(
+        pod_tilde_class,
+        (t_method)pod_tilde_set_resolutions,
+        gensym("resolutions"),
+        A_GIMME,
+        0
+            );
+    
+    class_addmethod(
+        pod_tilde_class,
+        (t_method)pod_tilde_info,
+        gensym("info"),
+        0
+            );
+    
+    class_addmethod(
+        pod_tilde_class,
+        (t_method)pod_tilde_set_power,
+        gensym("power"),
+        A_FLOAT,
+        0
+            );
+    
+    class_addmethod(
+        pod_tilde_class,
+        (t_method)pod_tilde_phase,
+        gensym("phase"),
+        A_GIMME,
+        0
+            );
+    
     
 }
 
 
-static void* pod_tilde_new(t_floatarg window_size, t_floatarg hop_size)
+static void* pod_tilde_new(t_floatarg window_size, t_floatarg hop_size, t_floatarg channels, t_floatarg latency)
 {
     
     post("pod~ v.0.1 by Gregoire Tronel, Jay Clark, and Scott McCoid");
     
     t_pod_tilde *x = (t_pod_tilde *)pd_new(pod_tilde_class);
+    t_pod_config config;
+    
+    x->channels = channels >= 1 ? (int) channels : 1;
+    x->inputs = (t_sample **)getbytes(x->channels * sizeof(t_sample *));
+    
+    // One signal inlet per channel, the leftmost comes from CLASS_MAINSIGNALIN
+    for (int i = 1; i < x->channels; i++)
+        inlet_new(&x->x_obj, &x->x_obj.ob_pd, &s_signal, &s_signal);
     
     // Leftmost outlet outputs a bang
     x->bang = outlet_new(&x->x_obj, &s_bang);
     x->mag_outlet = outlet_new(&x->x_obj, &s_float);
-    x->bin_diffs = outlet_new(&x->x_obj, &s_float);
-    
-    // Initialize filter coeffs
-    // Outer
-    x->o_a1 = 0.0;
-    x->o_a2 = 0.0;
-    x->o_b0 = 0.0;
-    x->o_b1 = 0.7221;
-    x->o_b2 = -0.6918;
-    
-    // Middle
-    x->m_a1 = 1.6456;
-    x->m_a2 = 0.6791;
-    x->m_b0 = 0.8383;
-    x->m_b1 = 0.0;
-    x->m_b2 = -0.8383;
-    
-    // Window Size
-    if (! isPowerOfTwo(window_size)){
-        post("Window size must be a power of two. Applying default window.");
-        x->window_size = 1024;
-    }
-    else x->window_size = window_size;
-    
-    x->half_window_size = x->window_size / 2;
-    
-    x->signal = (t_sample *)t_getbytes(x->window_size * sizeof(t_sample));
-    x->analysis = (t_sample *)t_getbytes(x->window_size * sizeof(t_sample));
-    x->window = (t_float *)t_getbytes(x->window_size * sizeof(t_float));
-    x->filtered_odd = (t_sample *)t_getbytes(x->half_window_size * sizeof(t_sample));
-    x->filtered_even= (t_sample *)t_getbytes(x->half_window_size * sizeof(t_sample));
-    
-    
-    for (int i = 0; i < x->window_size; i++)
+    x->bin_diffs = outlet_new(&x->x_obj, x->channels > 1 ? &s_list : &s_float);
+    
+    // With several channels the rightmost outlet says which one the following onset belongs to
+    x->channel_outlet = x->channels > 1 ? outlet_new(&x->x_obj, &s_float) : NULL;
+    
+    x->log_write = x->log_read = 0;
+    x->log_dropped = x->log_dropped_reported = 0;
+    x->log_clock = clock_new(x, (t_method)pod_tilde_drain_log);
+    
+    pod_config_init(&config);
+    config.window_size = window_size;
+    config.hop_size = hop_size;
+    config.channels = x->channels;
+    config.sample_rate = sys_getsr();
+    config.latency = latency;
+    config.onset = pod_tilde_onset;
+    config.flux = pod_tilde_flux;
+    config.log = pod_tilde_log;
+    config.user = x;
+    
+    x->pod = pod_create(&config);
+    pod_tilde_drain_log(x);
+    
+    if (x->pod == NULL)
     {
-        x->signal[i] = 0.0;
-        x->analysis[i] = 0.0;
-        x->window[i] = 0.0;
-    }
-    x->window_type = 0; //Default hanning
-    pod_tilde_create_window(x);
-    
-    // create arrays for each bark filter band
-    new_bark_bands(x);
-    
-    // create filter-bank associated with window size
-    create_filterbank(x);
-    
-    if (! isPowerOfTwo(hop_size)){
-        post("Hop size must be a power of two. Applying default hop size.");
-        x->hop_size = 256;
+        pd_error(x, "pod~: out of memory");
+        pd_free((t_pd *)x);
+        return NULL;
     }
-    else x->hop_size = hop_size; // This is in samples
-    x->dsp_tick = 0;
     
-    post("window size: %i", x->window_size);
-    post("hop size: %i", x->hop_size);
+    post("window size: %i", pod_get_window_size(x->pod));
+    post("hop size: %i", pod_get_hop_size(x->pod));
+    if (x->channels > 1)
+        post("channels: %i", x->channels);
+    if (pod_get_latency(x->pod) > 0)
+        post("latency: %i hops on a worker thread", pod_get_latency(x->pod));
+    post("fft: %s", pod_fft_backend_name());
+    post("phase: %i", pod_get_phase(x->pod));
     
+    return (void *)x;
+}
+
+#pragma mark - Perform -
+
+static t_int* pod_tilde_perform(t_int* w)
+{
+    t_pod_tilde *x = (t_pod_tilde *)(w[1]);     // x is the reference to the data struct
+    int          n =           (int)(w[2]);     // n is the number of samples passed to this function
     
-    //Peak picking.
-    
-    x->flag = 0;
-    x->debounce_iterator=0;
-    x->debounce_threshold=5;
-    x->u_threshold = 1000;
-    x->l_threshold = 10;
-    x->upper_threshold_scale = 10.0;
-    x->lower_threshold_scale = 1.0;
-    x->consecutive_onset_filtering_threshold = floor(30/(((x->hop_size)*1000)/FS));
-    x->consecutive_onset_filtering_iterator = 0;
-    x->consecutive_onset_flag = 0;
-    x->maskingDecay=0.7;
-    x->maskingThreshold=4;
-    x->maskIterator=0;
-    x->maskFlag = 0;
-    
+    // w[3] onwards are the input vectors, one per channel
+    for (int i = 0; i < x->channels; i++)
+        x->inputs[i] = (t_sample *)(w[3 + i]);
     
-    x->mean_vec.mean = 0.0;
-    x->mean_vec.num_values = 0;
+    pod_process_channels(x->pod, (const float * const *)x->inputs, n);
     
+    // Anything logged during this block gets posted once the scheduler is back on the main thread
+    if (__atomic_load_n(&x->log_write, __ATOMIC_RELAXED) != x->log_read)
+        clock_delay(x->log_clock, 0);
     
-    return (void *)x;
+    return (w + 3 + x->channels);
 }
 
-static void pod_tilde_create_window(t_pod_tilde* x)
+#pragma mark - Detector Callbacks -
+
+static void pod_tilde_onset(void* user, const t_pod_onset* onset)
 {
+    t_pod_tilde* x = (t_pod_tilde *)user;
     
-    switch (x->window_type) {
-        case 0:
-            // Hanning
-            for (int i = 0; i < x->window_size; i++)
-                x->window[i] = 0.5 * (1 - cos((TWO_PI * i) / (x->window_size - 1)));
-            break;
-            
-        case 1:
-            // Hamming
-            for (int i = 0; i < x->window_size; i++)
-                x->window[i] = 0.54 - 0.46 * (cos((TWO_PI * i) / (x->window_size - 1)));
-        default:
-            post("Unexpected windowing method");
-            break;
-    }
+    if (x->channel_outlet)
+        outlet_float(x->channel_outlet, onset->channel);
+    outlet_bang(x->bang);
+    outlet_float(x->mag_outlet, onset->peak);
 }
 
-static void new_bark_bands(t_pod_tilde* x)
+static void pod_tilde_flux(void* user, int channel, long long sample, float flux)
 {
-    for (int i = 0; i < NUM_BARK_FILTER_BUFS; i++)
+    t_pod_tilde* x = (t_pod_tilde *)user;
+    t_atom list[2];
+    
+    if (x->channels == 1)
     {
-        x->filter_bands[i].band = (t_float *)t_getbytes((x->window_size / 2) * sizeof(t_float));
-        
-        for (int j = 0; j < x->half_window_size; j++)
-            x->filter_bands[i].band[j] = 0.0;
+        outlet_float(x->bin_diffs, flux);
+        return;
     }
     
+    SETFLOAT(&list[0], channel);
+    SETFLOAT(&list[1], flux);
+    outlet_list(x->bin_diffs, &s_list, 2, list);
 }
 
-static void create_filterbank(t_pod_tilde* x)
+static void pod_tilde_log(void* user, const char* message)
 {
-    float period = FS / x->window_size;
-    int direction = 0;                     // direction is either +1 for increasing or -1 for decreasing
+    // Called from perform: a single producer push into a fixed ring, no locks, no allocation
+    t_pod_tilde* x = (t_pod_tilde *)user;
+    unsigned int write = x->log_write;
     
-    float length, slope, point;
-    
-    // NUM_BARKS is still 24, but we have an array of length 26, so we've added lower and upper limits
-    for (int i = 0; i < NUM_BARKS; i++)
+    if (write - __atomic_load_n(&x->log_read, __ATOMIC_ACQUIRE) == POD_TILDE_LOG_SIZE)
     {
-        for (int j = 0; j < x->half_window_size; j++)
-        {
-            float frequency = period * j;
-            
-            if (frequency >= bark_ctr[i] && frequency < bark_ctr[i + 1])
-            {
-                direction = 1;
-                length = bark_ctr[i + 1] - bark_ctr[i];
-            }
-            else if (frequency >= bark_ctr[i + 1] && frequency < bark_ctr[i + 2])
-            {
-                direction = -1;
-                length = bark_ctr[i + 2] - bark_ctr[i + 1];
-            }
-            else
-                direction = 0;  // this means we're over the bounds and don't want to deal with it
-            
-            if (direction != 0)
-            {
-                slope = direction / length;
-                point = 1 - slope * bark_ctr[i + 1];
-                
-                x->filter_bands[i % 2].band[j] = slope * frequency + point;         // y = mx + b
-            }
-        }
+        __atomic_add_fetch(&x->log_dropped, 1, __ATOMIC_RELAXED);
+        return;
     }
+    
+    x->log_ring[write & (POD_TILDE_LOG_SIZE - 1)] = message;
+    __atomic_store_n(&x->log_write, write + 1, __ATOMIC_RELEASE);
 }
 
-#pragma mark - Perform -
-
-static t_int* pod_tilde_perform(t_int* w)
+static void pod_tilde_drain_log(t_pod_tilde* x)
 {
-    t_pod_tilde *x = (t_pod_tilde *)(w[1]);     // x is the reference to the data struct
-    t_sample  *in1 =    (t_sample *)(w[2]);     // in1 is an array of input samples
-    int          n =           (int)(w[3]);     // n is the number of samples passed to this function
+    unsigned int write = __atomic_load_n(&x->log_write, __ATOMIC_ACQUIRE);
+    unsigned int read = x->log_read;
+    unsigned int dropped = __atomic_load_n(&x->log_dropped, __ATOMIC_RELAXED);
     
-    int size_diff = x->window_size - n;
-    
-    // This takes part of the signal buffer and shifts it to the front
-    for (int i = 0; i < size_diff; i++)
-        x->signal[i] = x->signal[i + n];
-    
-    // This takes the new samples filters them and puts them into the buffer
-    for (int i = 0; i < n; i++)
+    while (read != write)
     {
-        x->signal[size_diff + i] = pod_tilde_outer_filter(x, in1[i]);
-        x->signal[size_diff + i] = pod_tilde_middle_filter(x, x->signal[size_diff + i]);
+        post("%s", x->log_ring[read & (POD_TILDE_LOG_SIZE - 1)]);
+        read++;
     }
+    __atomic_store_n(&x->log_read, read, __ATOMIC_RELEASE);
     
-    // Increase the dsp_tick variable by the number of samples passed to callback
-    x->dsp_tick += n;
-    
-    // If the dsp_tick reaches the hop_size value, then we do our processing
-    if (x->dsp_tick >= x->hop_size)
+    if (dropped != x->log_dropped_reported)
     {
-        x->dsp_tick = 0;
-        
-        // do windowing
-        for (int i = 0; i < x->window_size; i++)
-            x->analysis[i] = x->signal[i] * x->window[i];           // analysis is windowed signal
-        
-        // take fft
-        mayer_realfft(x->window_size, x->analysis);
-        
-        // Zero out frequencies at DC and Nyquist
-        x->analysis[0] = 0.0;
-        x->analysis[x->window_size / 2] = 0.0;
-        
-        // scaling the analysis values by the window size
-        for (int i = 0; i < x->window_size; i++)
-            x->analysis[i] = x->analysis[i] / x->window_size;
-        
-        // Get the magnitude and assign it to the first half of the analysis buffer
-        for (int i = 0; i < x->window_size / 2; i++)
-        {
-            int i_index = x->window_size - i;
-            x->analysis[i] = sqrt((x->analysis[i] * x->analysis[i]) + (x->analysis[i_index] * x->analysis[i_index]));
-            //x->analysis[i] = (x->analysis[i] * x->analysis[i]) + (x->analysis[i_index] * x->analysis[i_index]);
-
-        }
-        
-        // multiply analysis buffer by the filterbank
-        multiply_filterbank(x);
-        
-        // turn analysis buffer into summed bark bins (i.e. turn 1 x half_windowsize vector -> 1 x 24 vector)
-        condense_analysis(x);
-        
-        // multiply by loudness curves
-        multiply_loudness(x);
-        
-        // -- spectral flux peak picking -- //
-        
-        //check for initial case
-        if (x->prev_bark_bins != NULL) {
-            
-            //subtract this frame from last to get to our feature space
-            x->bark_difference = accumulate_bin_differences(x);
-            
-            //masking
-            if (x->maskFlag == 1) {
-                if (x->maskIterator == x->maskingThreshold) {
-                    x->maskFlag = 0;
-                    x->maskIterator =0;
-                }
-                else
-                    for (int i =0; i<x->maskingThreshold-x->maskIterator; i++){
-                        x->bark_difference = x->bark_difference * x->maskingThreshold;
-                    }
-                x->maskIterator ++;
-            }
-            
-            
-            //Consecutive onset filtering
-            if (x->consecutive_onset_flag == 1) {
-                if (x->consecutive_onset_filtering_iterator > x->consecutive_onset_filtering_threshold) {
-                    x->consecutive_onset_flag = 0;
-                    x->consecutive_onset_filtering_iterator = 0;
-                }
-                else x->consecutive_onset_filtering_iterator++;
-            }
-            
-            //Is our flag raised?
-            switch (x->flag) {
-                    
-                case 0: //Flag is down.
-                    
-                    //Lets check if we're above the upper threshold
-                    if (x->bark_difference > x->u_threshold) {
-                        
-                        if (x->consecutive_onset_flag == 0) {
-                            
-                        //Let's flag this spot for a potential onset and hang on to that peak value if it ends up being one
-                        x->flag = 1;
-                        x->debounce_iterator = 1;
-                        x->peak_value=x->bark_difference;
-                            
-                        }
-                    }
-                    
-                    //otherwise, we'll keep waiting for an onset.
-                    
-                    break;
-                    
-                case 1: //Flag is up.
-                    
-                        
-                    //did we go even higher above the threshold?
-                    if (x->bark_difference > x->peak_value) {
-                        
-                        if (x->consecutive_onset_flag == 0) {
-                            
-                        //flag this as a better estimate for the onset.
-                        x->flag = 1;
-                        x->debounce_iterator = 1;
-                        x->peak_value = x->bark_difference;
-                            
-                        }
-                        
-                    }
-                    
-                    //if not...
-                    else{
-                        
-                        //Have we gone beyond our debouncing window?
-                        if (x->debounce_iterator > x->debounce_threshold) {
-                            
-                            if (x->consecutive_onset_flag == 0) {
-
-                            //onset verified!
-                            outlet_bang(x->bang);
-                            outlet_float(x->mag_outlet, x->peak_value);
-                            post("onset: debounce window exceeded");
-                            
-                            x->debounce_iterator = 0;
-                            x->flag = 0;
-                            x->consecutive_onset_flag=1;
-                            x->maskFlag = 1;
-                                
-                            }
-                            
-                            //else post("consecutive onset ignored");
-                            
-                        }
-                        
-                        else{
-                            
-                            //are we below our lower threshold?
-                            if(x->bark_difference < x->l_threshold){
-                                
-                                if (x->consecutive_onset_flag == 0) {
-                                    
-                                //onset verified!
-                                outlet_bang(x->bang);
-                                outlet_float(x->mag_outlet, x->peak_value);
-                                //post("onset: lower threshold");
-                                
-                                x->debounce_iterator = 0;
-                                x->flag = 0;
-                                x->consecutive_onset_flag=1;
-                                x->maskFlag = 1;
-                                
-                                }
-                                
-                                //else post("consecutive onset ignored");
-                                
-                            }
-                            
-                            //we have a peak flagged, but we haven't increased or crossed the lower threshold yet.
-                            //Lets wait a bit longer to make sure our tagged peak is an onset
-                            else x->debounce_iterator++;
-                        }
-                        
-                        
-                    }
-                    
-                    break;
-            }
-            
-            
-            if (x->automaticThresholding == 1) 
-            {
-                float new_mean = mean(x, x->bark_difference);
-                
-                x->u_threshold = new_mean * x->upper_threshold_scale;
-                x->l_threshold = new_mean * x->lower_threshold_scale;
-
-            }
-        }
-        
-        iterate_bark_bins(x);
-        
+        post("pod~: %u log messages dropped", dropped - x->log_dropped_reported);
+        x->log_dropped_reported = dropped;
     }
-    
-    return (w + 4);
 }
 
+#pragma mark - Memory Management -
 
-#pragma mark - Ear Filters -
-#pragma mark Outer and Middle Ear
-
-static t_float pod_tilde_outer_filter(t_pod_tilde* x, t_sample in)
+static void pod_tilde_free(t_pod_tilde* x)
 {
-    //a(1)*y(n) = b(1)*x(n) + b(2)*x(n-1) + ... + b(nb+1)*x(n-nb) - a(2)*y(n-1) - ... - a(na+1)*y(n-na)
-    static t_float o_x1 = 0.0;
-    static t_float o_x2 = 0.0;
-    static t_float o_y1 = 0.0;
-    static t_float o_y2 = 0.0;
-    t_float out = 0.0;
-    
-    out = x->o_b0 * in + x->o_b1 * o_x1 + x->o_b2 * o_x2 - x->o_a1 * o_y1 - x->o_a2 * o_y2;
-    
-    o_x2 = o_x1;
-    o_x1 = in;
-    o_y2 = o_y1;
-    o_y1 = out;
-    
-    return out;
+    pod_destroy(x->pod);
+    clock_free(x->log_clock);
+    freebytes(x->inputs, x->channels * sizeof(t_sample *));
 }
 
-static t_float pod_tilde_middle_filter(t_pod_tilde* x, t_sample in)
+#pragma mark - System Methods -
+
+
+static void pod_tilde_dsp(t_pod_tilde* x, t_signal** sp)
 {
-    static t_float m_x1 = 0.0;
-    static t_float m_x2 = 0.0;
-    static t_float m_y1 = 0.0;
-    static t_float m_y2 = 0.0;
-    t_float out = 0.0;
+    t_int* args = (t_int *)getbytes((2 + x->channels) * sizeof(t_int));
     
-    m_y1 = x->m_b0 * in + x->m_b1 * m_x1 + x->m_b2 * m_x2  - x->m_a2 * m_y2;
-    out = x->m_a2 * m_y1;
+    args[0] = (t_int)x;
+    args[1] = (t_int)sp[0]->s_n;
+    for (int i = 0; i < x->channels; i++)
+        args[2 + i] = (t_int)sp[i]->s_vec;
     
-    m_x2 = m_x1;
-    m_x1 = in;
-    m_y2 = m_y1;
-    m_y1 = out;
+    x->block_size = sp[0]->s_n;
     
-    return out;
+    // the filterbank follows the rate of the signal coming in, which only changes when the chain is rebuilt
+    if (pod_set_sample_rate(x->pod, sp[0]->s_sr) != 0)
+        pd_error(x, "pod~: could not follow the sample rate of %g", sp[0]->s_sr);
+    
+    dsp_addv(pod_tilde_perform, 2 + x->channels, args);
+    freebytes(args, (2 + x->channels) * sizeof(t_int));
 }
 
-#pragma mark Inner Ear
+#pragma mark - User Input -
 
-static void multiply_filterbank(t_pod_tilde* x)
-{
-    for (int i = 0; i < x->half_window_size; i++)
-    {
-        x->filtered_odd[i] = x->filter_bands[0].band[i] * x->analysis[i];           // non overlapping bands starting at 0
-        x->filtered_even[i] = x->filter_bands[1].band[i] * x->analysis[i];          // non overlapping bands starting at 50 (first bark center)
-        x->analysis[i] = x->filtered_odd[i] + x->filtered_even[i];
-    }
+static void pod_tilde_set_window_type(t_pod_tilde* x, t_float number){
+    
+    if (pod_set_window_type(x->pod, (int) number) != 0)
+        post("Invalid windowing parameter");
+        
 }
 
-static void condense_analysis(t_pod_tilde* x)
+static void pod_tilde_set_window_size(t_pod_tilde* x, t_float number)
 {
-    float period = FS / x->window_size;
-    
-    for (int i = 0; i < NUM_BARKS; i++)
-    {
-        for (int j = 0; j < x->half_window_size; j++)
-        {
-            float frequency = period * j;
-            
-            if (frequency >= bark_ctr[i] && frequency < bark_ctr[i + 2])
-                x->bark_bins[i] += x->analysis[j];
-        }
-    }
+    if (pod_set_window_size(x->pod, (int) number) != 0)
+        post("pod~: window size stays %i, the new one has to be a power of two", pod_get_window_size(x->pod));
+    else
+        post("window size: %i", pod_get_window_size(x->pod));
 }
 
-static void multiply_loudness(t_pod_tilde* x)
+static void pod_tilde_set_hop_size(t_pod_tilde* x, t_float number)
 {
-    for (int i = 0; i < NUM_BARKS; i++)
-        x->bark_bins[i] *= band_weightings[i];
+    if (pod_set_hop_size(x->pod, (int) number) != 0)
+        post("pod~: hop size stays %i, the new one has to be a power of two", pod_get_hop_size(x->pod));
+    else
+        post("hop size: %i", pod_get_hop_size(x->pod));
 }
 
-
-#pragma mark - Peak Picking Helper Functions -
-
-static t_float accumulate_bin_differences(t_pod_tilde* x){
-    
-    t_float diff = 0;
-    t_int length = sizeof(x->bark_bins) / sizeof(t_float);
-    for (int i = 0; i < length; i++){
-        diff += halfwave_rectify(fabs(x->bark_bins[i]) - fabs(x->prev_bark_bins[i]));
-    }
+static void pod_tilde_set_debounce_threshold(t_pod_tilde* x, t_float number){
     
-    outlet_float(x->bin_diffs, diff);
+    pod_set_debounce_threshold(x->pod, (int) number);
     
-    return diff;
 }
 
-static void iterate_bark_bins(t_pod_tilde* x){
+static void pod_tilde_set_upper_threshold(t_pod_tilde* x, t_float number){
     
-    t_int length = sizeof(x->bark_bins) / sizeof(t_float);
-    for (int i = 0; i < length; i++) {
-        x->prev_bark_bins[i] = x->bark_bins[i];
-    }
+    pod_set_upper_threshold(x->pod, number);
     
 }
 
-
-#pragma mark - Utilities -
-
-static int isPowerOfTwo(unsigned int x)
-{
-    //Complement and Compare
-    return ((x != 0) && ((x & (~x + 1)) == x));
-}
-
-static float halfwave_rectify(float value)
-{
-    return (value + fabs(value) / 2);
+static void pod_tilde_set_lower_threshold(t_pod_tilde* x, t_float number){
+    
+    pod_set_lower_threshold(x->pod, number);
+    
 }
 
-static float mean(t_pod_tilde* x, t_float new_value)
-{    
-    t_mean_vec* m = &x->mean_vec;
+static void pod_tilde_set_consecutive_threshold(t_pod_tilde* x, t_float number){
     
-    m->mean = (m->mean * m->num_values + new_value) / (m->num_values + 1);
-    m->num_values++;
+    pod_set_consecutive_threshold(x->pod, number);
     
-    return m->mean;
 }
 
-static void shift_queue(t_pod_tilde* x, t_float new_value)
+static void pod_tilde_set_upper_threshold_scale(t_pod_tilde* x, t_float number)
 {
-    for (int i = 0; i < QUEUE_SIZE - 1; i++)
-        x->queue[i] = x->queue[i + 1];
-    
-    x->queue[QUEUE_SIZE - 1] = new_value;
+    pod_set_upper_threshold_scale(x->pod, number);
 }
 
-#pragma mark - Memory Management -
-
-static void free_bark_bands(t_pod_tilde* x)
+static void pod_tilde_set_lower_threshold_scale(t_pod_tilde* x, t_float number)
 {
-    for (int i = 0; i < NUM_BARK_FILTER_BUFS; i++)
-        t_freebytes(x->filter_bands[i].band, (x->half_window_size) * sizeof(t_float));
+    pod_set_lower_threshold_scale(x->pod, number);
 }
 
-static void pod_tilde_free(t_pod_tilde* x)
+static void pod_tilde_set_average_window(t_pod_tilde* x, t_float number)
 {
-    t_freebytes(x->signal, x->window_size * sizeof(t_sample));
-    t_freebytes(x->analysis, x->window_size * sizeof(t_sample));
-    t_freebytes(x->window, x->window_size * sizeof(t_float));
-    
-    t_freebytes(x->filtered_odd, x->half_window_size * sizeof(t_sample));
-    t_freebytes(x->filtered_even, x->half_window_size * sizeof(t_sample));
-    
-    free_bark_bands(x);
+    if (pod_set_average_window(x->pod, number) != 0)
+        pd_error(x, "pod~: out of memory");
 }
 
-#pragma mark - System Methods -
-
-
-static void pod_tilde_dsp(t_pod_tilde* x, t_signal** sp)
+static void pod_tilde_set_average_percentile(t_pod_tilde* x, t_float number)
 {
-    dsp_add(pod_tilde_perform, 3, x, sp[0]->s_vec, sp[0]->s_n);
+    if (pod_set_average_percentile(x->pod, number) != 0)
+        post("pod~: percentile goes up to 100, or -1 for the mean");
 }
 
-#pragma mark - User Input -
+static void pod_tilde_average(t_pod_tilde* x)
+{
+    t_pod_average average;
+    
+    for (int i = 0; pod_get_average(x->pod, i, &average) == 0; i++)
+        post("pod~: channel %i flux over %i frames: mean %g, deviation %g, percentile %g",
+             i, average.frames, average.mean, average.deviation, average.percentile);
+}
 
-static void pod_tilde_set_window_type(t_pod_tilde* x, t_float number){
+static void pod_tilde_set_spread(t_pod_tilde* x, t_float number)
+{
+    int blocks;
     
-    int selection = (int) number;
-    if (selection>=0 & selection<=1) {
-        x->window_type = selection;
+    if (pod_set_spread(x->pod, number != 0) != 0)
+    {
+        post("pod~: spreading does not run with a worker thread, another engine than the fft or extra resolutions");
+        return;
     }
-    else (post("Invalid windowing parameter"));
     
+    blocks = pod_get_spread(x->pod);
+    if (blocks == 0)
+        return;
+    
+    // The added latency in samples depends on the block size, which is only known once dsp is on
+    if (x->block_size > 0)
+        post("pod~: each frame is spread over %i blocks, %i samples late%s", blocks, blocks * x->block_size,
+             blocks * x->block_size > pod_get_hop_size(x->pod) ? ", longer than a hop so the rest runs at once" : "");
+    else
+        post("pod~: each frame is spread over %i blocks", blocks);
 }
 
-static void pod_tilde_set_debounce_threshold(t_pod_tilde* x, t_float number){
-    
-    int selection = (int) number;
-    // need to add error checking
-    x->debounce_threshold = selection;
+static void pod_tilde_set_engine(t_pod_tilde* x, t_symbol* engine)
+{
+    int result;
+    
+    if (engine == gensym("fft"))
+        result = pod_set_engine(x->pod, POD_ENGINE_FFT);
+    else if (engine == gensym("sdft"))
+        result = pod_set_engine(x->pod, POD_ENGINE_SDFT);
+    else if (engine == gensym("bank"))
+        result = pod_set_engine(x->pod, POD_ENGINE_BANK);
+    else
+    {
+        post("pod~: engine is fft, sdft or bank");
+        return;
+    }
     
+    if (result != 0)
+        post("pod~: only the fft engine runs with a worker thread, spreading or extra resolutions");
 }
 
-static void pod_tilde_set_upper_threshold(t_pod_tilde* x, t_float number){
-    
-    // need to add error checking
-    x->u_threshold = number;
-    x->automaticThresholding = 0;
+static void pod_tilde_check_engine(t_pod_tilde* x)
+{
+    float error = pod_check_engine(x->pod);
     
+    if (error < 0.0)
+        post("pod~: check compares the sliding dft with the fft, send engine sdft first");
+    else
+        post("pod~: sliding dft is within %g of the fft, relative to the largest bin", error);
 }
 
-static void pod_tilde_set_lower_threshold(t_pod_tilde* x, t_float number){
-    
-    // need to add error checking
-    x->l_threshold = number;
-    x->automaticThresholding = 0;
+static void pod_tilde_set_resolutions(t_pod_tilde* x, t_symbol* s, int argc, t_atom* argv)
+{
+    // resolutions <size> [<size>] adds shorter windows for the upper bands, resolutions on its own drops them
+    int sizes[POD_MAX_RESOLUTIONS - 1];
+    int count = argc < POD_MAX_RESOLUTIONS - 1 ? argc : POD_MAX_RESOLUTIONS - 1;
     
+    for (int i = 0; i < count; i++)
+        sizes[i] = (int) atom_getfloat(argv + i);
+        
+    if (argc > POD_MAX_RESOLUTIONS - 1 || pod_set_resolutions(x->pod, sizes, count) != 0)
+        post("pod~: up to %i shorter windows, powers of two from 64 up to below the window size, with the fft engine and no spreading",
+             POD_MAX_RESOLUTIONS - 1);
+             
+    pod_tilde_post_resolutions(x);
 }
 
-static void pod_tilde_set_consecutive_threshold(t_pod_tilde* x, t_float number){
+static void pod_tilde_post_resolutions(t_pod_tilde* x)
+{
+    int sizes[POD_MAX_RESOLUTIONS], first_bands[POD_MAX_RESOLUTIONS];
+    int count = pod_get_resolutions(x->pod, sizes, first_bands);
+    char bands[128] = "";
+    int length = 0;
     
-    // need to add error checking
-    x->consecutive_onset_filtering_threshold = floor(number/(((x->hop_size)*1000)/FS));
+    for (int i = 0; i < count; i++)
+    {
+        int last = i + 1 < count ? first_bands[i + 1] : POD_NUM_BARKS;
+        
+        if (first_bands[i] < last)
+            length += snprintf(bands + length, sizeof(bands) - length, "%s%i-%i from %i", length ? ", " : "",
+                               first_bands[i], last - 1, sizes[i]);
+    }
     
+    post("pod~: Bark bands %s", bands);
 }
 
-static void pod_tilde_set_upper_threshold_scale(t_pod_tilde* x, t_float number)
+static void pod_tilde_info(t_pod_tilde* x)
 {
-    if (number == 0.0)
-        x->upper_threshold_scale = 0.01;
+    // What runs; test/check_kernels checks the kernel sets against the scalar one
+    char supported[64] = "";
+    int length = 0;
     
-    x->upper_threshold_scale = number;
-    x->automaticThresholding = 1;
+    for (int isa = 0; isa < POD_NUM_ISAS; isa++)
+        if (pod_cpu_supports(isa))
+            length += snprintf(supported + length, sizeof(supported) - length, "%s%s", length ? " " : "", pod_cpu_name(isa));
+            
+    post("pod~: %s kernels (this processor runs %s), %s fft", pod_cpu_name(pod_get_isa()), supported, pod_fft_backend_name());
+    post("pod~: window size %i, hop size %i, channels %i at %g Hz, phase %i, latency %i",
+         pod_get_window_size(x->pod), pod_get_hop_size(x->pod), x->channels, pod_get_sample_rate(x->pod),
+         pod_get_phase(x->pod), pod_get_latency(x->pod));
+    pod_tilde_post_resolutions(x);
 }
 
-static void pod_tilde_set_lower_threshold_scale(t_pod_tilde* x, t_float number)
+static void pod_tilde_set_power(t_pod_tilde* x, t_float number)
 {
-    if (number == 0.0)
-        x->lower_threshold_scale = 0.01;
-    
-    x->lower_threshold_scale = number;
-    x->automaticThresholding = 1;
+    pod_set_power(x->pod, number != 0);
 }
 
 static void pod_tilde_reset_average(t_pod_tilde* x)
 {
-    x->mean_vec.num_values = 0;
+    pod_reset_average(x->pod);
 }
 
+static void pod_tilde_profile(t_pod_tilde* x)
+{
+    // Posts the stage timings since the last report as one line of JSON, then starts a new interval
+    t_pod_profile profile;
+    char json[1024];
+    int length = 0;
+    
+    if (pod_get_profile(x->pod, &profile) != 0)
+    {
+        post("pod~: profiling needs a build with -DPOD_PROFILE");
+        return;
+    }
+    
+    length += snprintf(json + length, sizeof(json) - length,
+                       "{\"window_size\": %d, \"hop_size\": %d, \"fft\": \"%s\", \"samples\": %lld, \"frames\": %lld, \"stages\": {",
+                       pod_get_window_size(x->pod), pod_get_hop_size(x->pod), pod_fft_backend_name(),
+                       profile.samples, profile.frames);
+    
+    for (int i = 0; i < POD_NUM_STAGES; i++)
+    {
+        double ns_per_sample = profile.samples ? profile.ns[i] / profile.samples : 0.0;
+        double ns_per_frame = profile.frames ? profile.ns[i] / profile.frames : 0.0;
+        
+        length += snprintf(json + length, sizeof(json) - length,
+                           "%s\"%s\": {\"ns_per_sample\": %.3f, \"ns_per_frame\": %.1f}",
+                           i ? ", " : "", pod_stage_name(i), ns_per_sample, ns_per_frame);
+    }
+    
+    snprintf(json + length, sizeof(json) - length, "}}");
+    post("%s", json);
+    
+    pod_reset_profile(x->pod);
+}
 
-
-
-
-
-
-
-
-
-
-
-
-
-
-
-
-
-
-
-
-
-
-
-
+static void pod_tilde_phase(t_pod_tilde* x, t_symbol* s, int argc, t_atom* argv)
+{
+    // phase <samples> pins the frames to that point in the hop, phase auto hands it back to the scheduler,
+    // and either way (or on its own) it reports the busiest block across every pod~ in Pd
+    t_pod_schedule schedule;
+    
+    if (argc > 0 && argv[0].a_type == A_FLOAT)
+        pod_set_phase(x->pod, atom_getfloat(argv) >= 0 ? (int) atom_getfloat(argv) : -1);
+    else if (argc > 0 && atom_getsymbol(argv) == gensym("auto"))
+        pod_set_phase(x->pod, -1);
+    
+    pod_get_schedule(&schedule);
+    post("pod~: phase %i of %i, busiest block %.2f frames (mean %.2f) across %i detectors",
+         pod_get_phase(x->pod), pod_get_hop_size(x->pod), schedule.peak, schedule.mean, schedule.detectors);
+}
@@ -21,20 +21,11 @@
 // SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
 
 #include "m_pd.h"
+#include "libpod.h"
 
 static t_class  *pod_tilde_class;
 
-typedef struct _bark_bin
-{
-    t_float*    band;
-    
-} t_bark_bin;
-
-typedef struct _mean_vec
-{
-    t_float     mean;
-    t_int       num_values;
-} t_mean_vec;
+#define POD_TILDE_LOG_SIZE 64                   // power of two
 
 typedef struct _pod_tilde
 {
@@ -43,47 +34,19 @@ typedef struct _pod_tilde
     t_outlet*   bang;
     t_outlet*   mag_outlet;
     t_outlet*   bin_diffs;
-    t_float     o_a1, o_a2, o_b0, o_b1, o_b2;
-    t_float     m_a1, m_a2, m_b0, m_b1, m_b2;
-    t_sample*   signal;                         // this holds samples
-    t_sample*   analysis;                       // this holds analysis values
-    t_int       window_size;
-    t_float*    window;
-    t_int       window_type;
-    t_int       hop_size;
-    t_int       dsp_tick;
-    t_int       half_window_size;
-    
-    //peak picking
-    t_float     bark_bins[24];
-    t_float     prev_bark_bins[24];
-    t_float     u_threshold, l_threshold;
-    t_float     bark_difference;
-    t_float     peak_value;
-    t_int       flag;
-    t_int       debounce_iterator;
-    t_int       debounce_threshold;
-    t_mean_vec  mean_vec;
-    t_int       consecutive_onset_filtering_threshold;
-    t_int       consecutive_onset_filtering_iterator;
-    t_int       consecutive_onset_flag;
-    t_float     lower_threshold_scale;
-    t_float     upper_threshold_scale;
-    t_int       maskingThreshold;
-    t_float     maskingDecay;
-    t_int       maskFlag;
-    t_int       maskIterator;
-    t_int       automaticThresholding;
-    
-    // filterbank
-    t_bark_bin  filter_bands[2];
-    t_sample*   filtered_odd;
-    t_sample*   filtered_even;
-    
-    // poor man's queue
-    t_float     queue[10000];
-    t_int       current_queue_size;
+    t_outlet*   channel_outlet;                 // only with more than one channel
+    t_pod*      pod;                            // the detector itself, see libpod.h
+    int         channels;
+    int         block_size;                     // from the last dsp message, 0 before
+    t_sample**  inputs;                         // one signal vector per channel, gathered in perform
     
+    // diagnostics raised in perform wait here until the clock posts them from the main thread
+    const char* log_ring[POD_TILDE_LOG_SIZE];
+    unsigned int log_write;                     // only moved by pod_tilde_log
+    unsigned int log_read;                      // only moved by pod_tilde_drain_log
+    unsigned int log_dropped;                   // messages lost to a full ring
+    unsigned int log_dropped_reported;
+    t_clock*    log_clock;
     
 } t_pod_tilde;
 
@@ -91,36 +54,18 @@ typedef struct _pod_tilde
 
 //Initialization
 void pod_tilde_setup(void);
-static void* pod_tilde_new(t_floatarg window_size, t_floatarg hop_size);
-static void pod_tilde_create_window(t_pod_tilde* x);
-static void new_bark_bands(t_pod_tilde* x);
-static void create_filterbank(t_pod_tilde* x);
+static void* pod_tilde_new(t_floatarg window_size, t_floatarg hop_size, t_floatarg channels, t_floatarg latency);
 
 //Perform
 static t_int* pod_tilde_perform(t_int* w);
 
-//Ear Filters
-    //Outer Ear
-static t_float pod_tilde_outer_filter(t_pod_tilde* x, t_sample in);
-static t_float pod_tilde_middle_filter(t_pod_tilde* x, t_sample in);
-
-    //Inner Ear
-static void multiply_filterbank(t_pod_tilde* x);
-static void condense_analysis(t_pod_tilde* x);
-static void multiply_loudness(t_pod_tilde* x);
-
-//Peak Picking Helper Functions
-static t_float accumulate_bin_differences(t_pod_tilde* x);
-static void iterate_bark_bins(t_pod_tilde* x);
-
-//Utilities
-static int isPowerOfTwo(unsigned int x);
-static float halfwave_rectify(float value);
-static float mean(t_pod_tilde* x, t_float new_value);
-static void shift_queue(t_pod_tilde* x, t_float new_value);
+//Detector Callbacks
+static void pod_tilde_onset(void* user, const t_pod_onset* onset);
+static void pod_tilde_flux(void* user, int channel, long long sample, float flux);
+static void pod_tilde_log(void* user, const char* message);
+static void pod_tilde_drain_log(t_pod_tilde* x);
 
 //Memory managment
-static void free_bark_bands(t_pod_tilde* x);
 static void pod_tilde_free(t_pod_tilde* x);
 
 //DSP
@@ -128,13 +73,27 @@ static void pod_tilde_dsp(t_pod_tilde* x, t_signal** sp);
 
 //User Input
 static void pod_tilde_set_window_type(t_pod_tilde* x, t_float number);
+static void pod_tilde_set_window_size(t_pod_tilde* x, t_float number);
+static void pod_tilde_set_hop_size(t_pod_tilde* x, t_float number);
 static void pod_tilde_set_debounce_threshold(t_pod_tilde* x, t_float number);
 static void pod_tilde_set_upper_threshold(t_pod_tilde* x, t_float number);
 static void pod_tilde_set_lower_threshold(t_pod_tilde* x, t_float number);
 static void pod_tilde_set_consecutive_threshold(t_pod_tilde* x, t_float number);
 static void pod_tilde_set_upper_threshold_scale(t_pod_tilde* x, t_float number);
 static void pod_tilde_set_lower_threshold_scale(t_pod_tilde* x, t_float number);
+static void pod_tilde_set_average_window(t_pod_tilde* x, t_float number);
+static void pod_tilde_set_average_percentile(t_pod_tilde* x, t_float number);
+static void pod_tilde_average(t_pod_tilde* x);
+static void pod_tilde_set_spread(t_pod_tilde* x, t_float number);
+static void pod_tilde_set_engine(t_pod_tilde* x, t_symbol* engine);
+static void pod_tilde_check_engine(t_pod_tilde* x);
+static void pod_tilde_set_resolutions(t_pod_tilde* x, t_symbol* s, int argc, t_atom* argv);
+static void pod_tilde_post_resolutions(t_pod_tilde* x);
+static void pod_tilde_info(t_pod_tilde* x);
+static void pod_tilde_set_power(t_pod_tilde* x, t_float number);
 static void pod_tilde_reset_average(t_pod_tilde* x);
+static void pod_tilde_profile(t_pod_tilde* x);
+static void pod_tilde_phase(t_pod_tilde* x, t_symbol* s, int argc, t_atom* argv);
 
 
 
@@ -0,0 +1,197 @@
+//
+//  bench.c
+//  pod
+//
+//
+// Copyright (C) 2012 Scott McCoid, Gregoire Tronel, Jay Clark
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy of this software
+// and associated documentation files (the "Software"), to deal in the Software without restriction,
+// including without limitation the rights to use, copy, modify, merge, publish, distribute, sublicense,
+// and/or sell copies of the Software, and to permit persons to whom the Software is furnished to do so,
+// subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in all copies or substantial
+// portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR IMPLIED, INCLUDING BUT NOT
+// LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.
+// IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY,
+// WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE
+// SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+
+
+// Times libpod over a sweep of window sizes, hop sizes and detector counts, using the stage timings of a
+// build with -DPOD_PROFILE, and prints the results as JSON:
+//
+//     bench [-e fft|sdft|bank] [-d seconds] [-b block] [-i isa] [-n counts] [-w min,max] [-H min,max]
+//
+// Windows and hops run over the powers of two from 256 to 8192 and from 32 to 1024, skipping hops longer
+// than the window, and the detector counts default to 1,4,16. Every detector in a run gets its own copy of
+// the same white noise, at the phase the scheduler picks. Per run:
+//
+//     ns_per_sample        every stage's time over the samples each detector took in, summed over detectors
+//     ns_per_frame         the frame stages' time (everything but the ear filter) over the frames run
+//     wall_ns_per_sample   the whole run by the clock, over the samples each detector took in
+//     stages               each stage's share of the above, by sample and by frame
+
+#include "libpod.h"
+#include "pod_fft.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+
+#ifndef POD_PROFILE
+#error bench needs libpod built with -DPOD_PROFILE
+#endif
+
+#define BENCH_MAX_COUNTS 8
+
+static double now_ns(void)
+{
+    struct timespec t;
+    
+    clock_gettime(CLOCK_MONOTONIC, &t);
+    return t.tv_sec * 1e9 + t.tv_nsec;
+}
+
+static int parse_range(const char* text, int* low, int* high)
+{
+    return sscanf(text, "%d,%d", low, high) == 2 ? 0 : -1;
+}
+
+static int run(int window, int hop, int count, int engine, const float* noise, int length, int block, int first)
+{
+    t_pod** pods = (t_pod **)calloc(count, sizeof(t_pod *));
+    t_pod_profile total, one;
+    t_pod_config config;
+    double start, wall, frame_ns = 0.0, sample_ns = 0.0;
+    
+    pod_config_init(&config);
+    config.window_size = window;
+    config.hop_size = hop;
+    config.engine = engine;
+    
+    for (int i = 0; i < count; i++)
+        if ((pods[i] = pod_create(&config)) == NULL)
+            return -1;
+            
+    start = now_ns();
+    for (int at = 0; at + block <= length; at += block)
+        for (int i = 0; i < count; i++)
+            pod_process_block(pods[i], noise + at, block);
+    wall = now_ns() - start;
+    
+    memset(&total, 0, sizeof(total));
+    for (int i = 0; i < count; i++)
+    {
+        pod_get_profile(pods[i], &one);
+        for (int s = 0; s < POD_NUM_STAGES; s++)
+            total.ns[s] += one.ns[s];
+        total.samples += one.samples;
+        total.frames += one.frames;
+        pod_destroy(pods[i]);
+    }
+    free(pods);
+    
+    for (int s = 0; s < POD_NUM_STAGES; s++)
+    {
+        sample_ns += total.ns[s];
+        if (s != POD_STAGE_EAR_FILTER)
+            frame_ns += total.ns[s];
+    }
+    
+    printf("%s\n    {\"window_size\": %d, \"hop_size\": %d, \"detectors\": %d, \"samples\": %lld, \"frames\": %lld, "
+           "\"ns_per_sample\": %.3f, \"ns_per_frame\": %.1f, \"wall_ns_per_sample\": %.3f, \"stages\": {",
+           first ? "" : ",", window, hop, count, total.samples, total.frames,
+           total.samples ? sample_ns / total.samples : 0.0, total.frames ? frame_ns / total.frames : 0.0,
+           total.samples ? wall / total.samples : 0.0);
+           
+    for (int s = 0; s < POD_NUM_STAGES; s++)
+        printf("%s\"%s\": {\"ns_per_sample\": %.3f, \"ns_per_frame\": %.1f}", s ? ", " : "", pod_stage_name(s),
+               total.samples ? total.ns[s] / total.samples : 0.0, total.frames ? total.ns[s] / total.frames : 0.0);
+    printf("}}");
+    fflush(stdout);
+    return 0;
+}
+
+int main(int argc, char** argv)
+{
+    int engine = POD_ENGINE_FFT, block = 64, isa = -1, option;
+    int counts[BENCH_MAX_COUNTS] = { 1, 4, 16 }, num_counts = 3;
+    int window_low = 256, window_high = 8192, hop_low = 32, hop_high = 1024;
+    float seconds = 2.0f;
+    static const char* engines[] = { "fft", "sdft", "bank" };
+    unsigned int state = 1;
+    float* noise;
+    int length, first = 1;
+    
+    while ((option = getopt(argc, argv, "e:d:b:i:n:w:H:")) != -1)
+    {
+        switch (option)
+        {
+            case 'e':
+                for (engine = 0; engine < 3 && strcmp(optarg, engines[engine]) != 0; engine++)
+                    ;
+                break;
+            case 'd': seconds = atof(optarg); break;
+            case 'b': block = atoi(optarg); break;
+            case 'i':
+                for (isa = 0; isa < POD_NUM_ISAS && strcmp(optarg, pod_cpu_name(isa)) != 0; isa++)
+                    ;
+                break;
+            case 'n':
+                num_counts = 0;
+                for (char* token = strtok(optarg, ","); token && num_counts < BENCH_MAX_COUNTS; token = strtok(NULL, ","))
+                    counts[num_counts++] = atoi(token);
+                break;
+            case 'w':
+                if (parse_range(optarg, &window_low, &window_high) != 0)
+                    return 2;
+                break;
+            case 'H':
+                if (parse_range(optarg, &hop_low, &hop_high) != 0)
+                    return 2;
+                break;
+            default:
+                fprintf(stderr, "usage: bench [-e fft|sdft|bank] [-d seconds] [-b block] [-i isa] [-n counts] [-w min,max] [-H min,max]\n");
+                return 2;
+        }
+    }
+    
+    if (engine == 3 || block < 1 || (isa >= 0 && (isa == POD_NUM_ISAS || pod_set_isa(isa) != 0)))
+    {
+        fprintf(stderr, "bench: no such engine or kernels, or a block under 1\n");
+        return 2;
+    }
+    
+    pod_init();
+    length = (int)(seconds * 44100.0f);
+    noise = (float *)malloc(length * sizeof(float));
+    for (int i = 0; i < length; i++)
+    {
+        state = state * 1664525u + 1013904223u;
+        noise[i] = 0.5f * ((state >> 8) * (2.0f / 16777216.0f) - 1.0f);
+    }
+    
+    printf("{\"fft\": \"%s\", \"isa\": \"%s\", \"engine\": \"%s\", \"seconds\": %g, \"block\": %d, \"runs\": [",
+           pod_fft_backend_name(), pod_cpu_name(pod_get_isa()), engines[engine], seconds, block);
+           
+    for (int window = window_low; window <= window_high; window *= 2)
+        for (int hop = hop_low; hop <= hop_high && hop <= window; hop *= 2)
+            for (int c = 0; c < num_counts; c++)
+            {
+                if (run(window, hop, counts[c], engine, noise, length, block, first) != 0)
+                {
+                    fprintf(stderr, "bench: could not create %d detectors of %d / %d\n", counts[c], window, hop);
+                    return 1;
+                }
+                first = 0;
+            }
+            
+    printf("\n]}\n");
+    free(noise);
+    return 0;
+}
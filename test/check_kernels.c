@@ -0,0 +1,397 @@
+//
+//  check_kernels.c
+//  pod
+//
+//
+// Copyright (C) 2012 Scott McCoid, Gregoire Tronel, Jay Clark
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy of this software
+// and associated documentation files (the "Software"), to deal in the Software without restriction,
+// including without limitation the rights to use, copy, modify, merge, publish, distribute, sublicense,
+// and/or sell copies of the Software, and to permit persons to whom the Software is furnished to do so,
+// subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in all copies or substantial
+// portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR IMPLIED, INCLUDING BUT NOT
+// LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.
+// IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY,
+// WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE
+// SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+
+
+// Checks every vector kernel set this processor runs against the scalar reference. The SSE2, AVX and NEON
+// biquads reorder the recursion into multiply-adds over a run of outputs, so they are not bit exact; what
+// they must be is close. Differences are the largest from the scalar kernel, relative to its largest output:
+//
+//      ear filter              libpod's outer and middle ear sections, alone and together, within EAR_TOLERANCE,
+//                              about two float ulps of the largest output
+//      shelves                 a cookbook lift, highpass and lowpass, within SOS_TOLERANCE
+//      resonant                poles right by the unit circle, four sections deep, within RESONANT_TOLERANCE
+//      filterbank resonators   largest envelope difference from the scalar bank within BANK_TOLERANCE
+//      whole detectors         pod_check_isa within DETECTOR_TOLERANCE, over windows and channel counts
+//
+// The resonant cascade is reported as its own case because float cannot follow it closely either way: the
+// scalar kernel is itself out by about 2.5e-3 against double precision, and the reordered sums by 1.1e-2 to
+// 1.6e-2 more. Its bound only catches a kernel that has gone wrong, not one that has lost a little. The
+// side by side kernels run the scalar recursion a channel per lane and have to meet the same bounds. Each
+// cascade is run on noise, impulses and steps in blocks of awkward lengths so the state is handed from run
+// to run and the scalar tails get used, and on 1 to 9 channels side by side. Exits with 1 if any kernel is
+// out of tolerance.
+
+#include "libpod.h"
+#include "pod_bank.h"
+#include "pod_cpu.h"
+#include "pod_sos.h"
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#define EAR_TOLERANCE 2.5e-7
+#define SOS_TOLERANCE 1e-4
+#define RESONANT_TOLERANCE 3e-2
+#define BANK_TOLERANCE 1e-5
+#define DETECTOR_TOLERANCE 1e-5
+
+#define CHECK_LENGTH 8192
+#define CHECK_MAX_CHANNELS 9
+#define CHECK_SAMPLE_RATE 44100.0
+
+// Band limits and centres as libpod has them; the bank reads centres from the second entry on
+static const int bark_edges[POD_BANK_BANDS + 1] = { 20, 100, 200, 300, 400, 510, 630, 770, 920, 1080, 1270, 1480, 1720, 2000, 2320, 2700, 3150, 3700, 4400, 5300, 6400, 7700, 9500, 12000, 15500 };
+static const int bark_centres[POD_BANK_BANDS] = { 50, 150, 250, 350, 450, 570, 700, 840, 1000, 1170, 1370, 1600, 1850, 2150, 2500, 2900, 3400, 4000, 4800, 5800, 7000, 8500, 10500, 13500 };
+
+// Lengths the input is cut into, round and round, so every kernel starts runs at every offset
+static const int block_lengths[] = { 64, 1, 3, 7, 128, 5, 17, 8, 256, 31, 2, 100 };
+#define NUM_BLOCK_LENGTHS (int)(sizeof(block_lengths) / sizeof(block_lengths[0]))
+
+static float input[CHECK_MAX_CHANNELS][CHECK_LENGTH];
+
+#pragma mark - Filters -
+
+typedef enum { LOWPASS, HIGHPASS, PEAK } t_shape;
+
+// An RBJ cookbook biquad, normalised by a0
+static void add_biquad(t_pod_sos* f, t_shape shape, double frequency, double q, double gain_db)
+{
+    double w = 2.0 * M_PI * frequency / CHECK_SAMPLE_RATE;
+    double alpha = sin(w) / (2.0 * q), c = cos(w), a = pow(10.0, gain_db / 40.0);
+    double b0, b1, b2, a0, a1, a2;
+    
+    switch (shape)
+    {
+        case LOWPASS:
+            b0 = b2 = (1.0 - c) / 2.0;
+            b1 = 1.0 - c;
+            a0 = 1.0 + alpha; a1 = -2.0 * c; a2 = 1.0 - alpha;
+            break;
+        case HIGHPASS:
+            b0 = b2 = (1.0 + c) / 2.0;
+            b1 = -(1.0 + c);
+            a0 = 1.0 + alpha; a1 = -2.0 * c; a2 = 1.0 - alpha;
+            break;
+        default:
+            b0 = 1.0 + alpha * a; b1 = -2.0 * c; b2 = 1.0 - alpha * a;
+            a0 = 1.0 + alpha / a; a1 = -2.0 * c; a2 = 1.0 - alpha / a;
+            break;
+    }
+    
+    pod_sos_add_section(f, b0 / a0, b1 / a0, b2 / a0, a1 / a0, a2 / a0);
+}
+
+// The cascades checked, each with the largest difference from the scalar kernel it may show
+typedef struct _cascade
+{
+    const char* name;
+    double      tolerance;
+    
+} t_cascade;
+
+static const t_cascade cascades[] =
+{
+    { "outer",      EAR_TOLERANCE },            // libpod's outer ear section
+    { "middle",     EAR_TOLERANCE },            // libpod's middle ear section
+    { "ear",        EAR_TOLERANCE },            // both, as libpod runs them
+    { "shelves",    SOS_TOLERANCE },            // a lift, a highpass and a lowpass from the cookbook
+    { "resonant",   RESONANT_TOLERANCE },       // poles right by the unit circle, four sections deep
+};
+
+#define NUM_CASCADES (int)(sizeof(cascades) / sizeof(cascades[0]))
+
+static void make_cascade(t_pod_sos* f, int which)
+{
+    pod_sos_init(f);
+    
+    // the ear sections with libpod's coefficients, see create_ear_filter
+    if (which == 0 || which == 2)
+        pod_sos_add_section(f, 0.0, 0.7221, -0.6918, 0.0, 0.0);
+    if (which == 1 || which == 2)
+        pod_sos_add_section(f, 0.6791 * 0.8383, 0.0, 0.6791 * -0.8383, 0.6791, 0.0);
+        
+    if (which == 3)
+    {
+        add_biquad(f, PEAK, 3000.0, 1.0, 12.0);
+        add_biquad(f, HIGHPASS, 500.0, 0.7, 0.0);
+        add_biquad(f, LOWPASS, 8000.0, 0.7, 0.0);
+    }
+    else if (which == 4)
+    {
+        add_biquad(f, PEAK, 40.0, 20.0, 18.0);
+        add_biquad(f, LOWPASS, 60.0, 8.0, 0.0);
+        add_biquad(f, HIGHPASS, 20.0, 0.7, 0.0);
+        add_biquad(f, PEAK, 12000.0, 4.0, -12.0);
+    }
+}
+
+#pragma mark - Checks -
+
+// The cascade with the same coefficients, in double precision
+static void process_exact(const t_pod_sos* f, const float* in, double* out, int n)
+{
+    for (int i = 0; i < n; i++)
+        out[i] = in[i];
+        
+    for (int k = 0; k < f->num_sections; k++)
+    {
+        const t_pod_sos_section* s = &f->section[k];
+        double x1 = 0.0, x2 = 0.0, y1 = 0.0, y2 = 0.0;
+        
+        for (int i = 0; i < n; i++)
+        {
+            double x0 = out[i];
+            double y0 = s->b0 * x0 + s->b1 * x1 + s->b2 * x2 - s->a1 * y1 - s->a2 * y2;
+            
+            x2 = x1;
+            x1 = x0;
+            y2 = y1;
+            y1 = y0;
+            out[i] = y0;
+        }
+    }
+}
+
+// Largest difference from the expected output, relative to the largest expected one; stride picks a channel
+static double difference(const float* actual, int stride, const float* expected, int n)
+{
+    double worst = 0.0, largest = 0.0;
+    
+    for (int i = 0; i < n; i++)
+    {
+        worst = fmax(worst, fabs(actual[i * stride] - expected[i]));
+        largest = fmax(largest, fabs(expected[i]));
+    }
+    return largest > 0.0 ? worst / largest : worst;
+}
+
+// The same against the exact output
+static double error(const float* actual, const double* exact, int n)
+{
+    double worst = 0.0, largest = 0.0;
+    
+    for (int i = 0; i < n; i++)
+    {
+        worst = fmax(worst, fabs(actual[i] - exact[i]));
+        largest = fmax(largest, fabs(exact[i]));
+    }
+    return largest > 0.0 ? worst / largest : worst;
+}
+
+// One channel through pod_sos_process_isa against the scalar kernel; the scalar kernel's own error against
+// double precision comes back in *scalar
+static double check_sos(int which, t_pod_isa isa, double* scalar)
+{
+    static float actual[CHECK_LENGTH], expected[CHECK_LENGTH];
+    static double exact[CHECK_LENGTH];
+    t_pod_sos filter, reference;
+    
+    make_cascade(&filter, which);
+    make_cascade(&reference, which);
+    process_exact(&filter, input[0], exact, CHECK_LENGTH);
+    
+    for (int at = 0, k = 0; at < CHECK_LENGTH; k = (k + 1) % NUM_BLOCK_LENGTHS)
+    {
+        int n = block_lengths[k] < CHECK_LENGTH - at ? block_lengths[k] : CHECK_LENGTH - at;
+        
+        pod_sos_process_isa(&filter, input[0] + at, actual + at, n, isa);
+        pod_sos_process_scalar(&reference, input[0] + at, expected + at, n);
+        at += n;
+    }
+    
+    *scalar = error(expected, exact, CHECK_LENGTH);
+    return difference(actual, 1, expected, CHECK_LENGTH);
+}
+
+// Channels side by side through pod_sos_process_channels_isa, against each channel alone through the scalar
+// kernel; returns the worst channel's difference
+static double check_sos_channels(int which, int channels, t_pod_isa isa)
+{
+    static float actual[CHECK_MAX_CHANNELS * CHECK_LENGTH], expected[CHECK_LENGTH];
+    static float state[CHECK_MAX_CHANNELS * 4 * POD_SOS_MAX_SECTIONS + 64];
+    const float* in[CHECK_MAX_CHANNELS];
+    double worst = 0.0;
+    t_pod_sos filter;
+    
+    make_cascade(&filter, which);
+    memset(state, 0, pod_sos_channel_state_size(&filter, channels) * sizeof(float));
+    for (int c = 0; c < channels; c++)
+        in[c] = input[c];
+        
+    for (int at = 0, k = 0; at < CHECK_LENGTH; k = (k + 1) % NUM_BLOCK_LENGTHS)
+    {
+        int n = block_lengths[k] < CHECK_LENGTH - at ? block_lengths[k] : CHECK_LENGTH - at;
+        
+        pod_sos_process_channels_isa(&filter, state, channels, in, at, actual + at * channels, n, isa);
+        at += n;
+    }
+    
+    for (int c = 0; c < channels; c++)
+    {
+        t_pod_sos reference;
+        
+        make_cascade(&reference, which);
+        pod_sos_process_scalar(&reference, input[c], expected, CHECK_LENGTH);
+        worst = fmax(worst, difference(actual + c, channels, expected, CHECK_LENGTH));
+    }
+    
+    return worst;
+}
+
+// The filterbank's resonators on every channel, compared through the envelopes they feed
+static float check_bank(int channels, t_pod_isa isa)
+{
+    static float history[CHECK_LENGTH * CHECK_MAX_CHANNELS];
+    float actual[POD_BANK_BANDS], expected[POD_BANK_BANDS];
+    float difference = 0.0f, largest = 0.0f;
+    t_pod_bank* bank = pod_bank_create(bark_edges, bark_centres, CHECK_SAMPLE_RATE, channels);
+    t_pod_bank* reference = pod_bank_create(bark_edges, bark_centres, CHECK_SAMPLE_RATE, channels);
+    
+    if (bank == NULL || reference == NULL)
+        return INFINITY;
+        
+    for (int i = 0; i < CHECK_LENGTH; i++)
+        for (int c = 0; c < channels; c++)
+            history[i * channels + c] = input[c][i];
+            
+    for (int at = 0, k = 0; at < CHECK_LENGTH; k = (k + 1) % NUM_BLOCK_LENGTHS)
+    {
+        int n = block_lengths[k] < CHECK_LENGTH - at ? block_lengths[k] : CHECK_LENGTH - at;
+        
+        pod_bank_update_isa(bank, history, CHECK_LENGTH, at, n, isa);
+        pod_bank_update_isa(reference, history, CHECK_LENGTH, at, n, POD_ISA_SCALAR);
+        at += n;
+        
+        for (int c = 0; c < channels; c++)
+        {
+            pod_bank_envelopes(bank, c, actual, 0);
+            pod_bank_envelopes(reference, c, expected, 0);
+            for (int b = 0; b < POD_BANK_BANDS; b++)
+            {
+                difference = fmaxf(difference, fabsf(actual[b] - expected[b]));
+                largest = fmaxf(largest, fabsf(expected[b]));
+            }
+        }
+    }
+    
+    pod_bank_destroy(bank);
+    pod_bank_destroy(reference);
+    return largest > 0.0f ? difference / largest : difference;
+}
+
+// Every kernel a detector runs, through pod_check_isa, with its own coefficients, window and filterbank
+static float check_detectors(t_pod_isa isa)
+{
+    static const int window_sizes[] = { 256, 1024, 4096 };
+    static const int channel_counts[] = { 1, 2, 5 };
+    float worst = 0.0f;
+    
+    for (int w = 0; w < 3; w++)
+    {
+        for (int c = 0; c < 3; c++)
+        {
+            t_pod_config config;
+            t_pod* pod;
+            float error;
+            
+            pod_config_init(&config);
+            config.window_size = window_sizes[w];
+            config.hop_size = window_sizes[w] / 4;
+            config.channels = channel_counts[c];
+            
+            pod = pod_create(&config);
+            if (pod == NULL)
+                return INFINITY;
+                
+            error = pod_check_isa(pod, isa);
+            pod_destroy(pod);
+            
+            worst = fmaxf(worst, error < 0.0f ? INFINITY : error);
+        }
+    }
+    
+    return worst;
+}
+
+#pragma mark - Main -
+
+int main(void)
+{
+    unsigned int state = 1;
+    int failures = 0, checked = 0;
+    
+    // Noise, with an impulse and a step on each channel at its own place
+    for (int c = 0; c < CHECK_MAX_CHANNELS; c++)
+    {
+        for (int i = 0; i < CHECK_LENGTH; i++)
+        {
+            state = state * 1664525u + 1013904223u;
+            input[c][i] = 0.25f * ((state >> 8) * (2.0f / 16777216.0f) - 1.0f);
+        }
+        input[c][1000 + 97 * c] += 1.0f;
+        for (int i = 4000 + 131 * c; i < 6000; i++)
+            input[c][i] += 0.5f;
+    }
+    
+    printf("# largest difference from the scalar kernel, relative to its largest output (tolerance)\n");
+    
+    for (int isa = POD_ISA_SCALAR + 1; isa < POD_NUM_ISAS; isa++)
+    {
+        float worst_bank = 0.0f, worst_detector;
+        
+        if (! pod_cpu_supports(isa))
+            continue;
+            
+        for (int which = 0; which < NUM_CASCADES; which++)
+        {
+            double scalar, single = check_sos(which, isa, &scalar), side_by_side = 0.0;
+            double tolerance = cascades[which].tolerance;
+            
+            for (int channels = 1; channels <= CHECK_MAX_CHANNELS; channels++)
+                side_by_side = fmax(side_by_side, check_sos_channels(which, channels, isa));
+                
+            printf("%-7s %-10s biquads   %.2e (%g), scalar against double %.2e%s\n", pod_cpu_name(isa),
+                   cascades[which].name, single, tolerance, scalar, single <= tolerance ? "" : "  FAILED");
+            printf("%-7s %-10s channels  %.2e (%g)%s\n", pod_cpu_name(isa), cascades[which].name, side_by_side,
+                   tolerance, side_by_side <= tolerance ? "" : "  FAILED");
+            failures += (single > tolerance) + (side_by_side > tolerance);
+        }
+        
+        for (int channels = 1; channels <= CHECK_MAX_CHANNELS; channels += 4)
+            worst_bank = fmaxf(worst_bank, check_bank(channels, isa));
+        printf("%-7s filterbank            %.2e against scalar%s\n", pod_cpu_name(isa), worst_bank,
+               worst_bank <= BANK_TOLERANCE ? "" : "  FAILED");
+        failures += worst_bank > BANK_TOLERANCE;
+        
+        worst_detector = check_detectors(isa);
+        printf("%-7s detectors             %.2e against scalar%s\n", pod_cpu_name(isa), worst_detector,
+               worst_detector <= DETECTOR_TOLERANCE ? "" : "  FAILED");
+        failures += ! (worst_detector <= DETECTOR_TOLERANCE);
+        checked++;
+    }
+    
+    if (checked == 0)
+        printf("no vector kernels on this processor or build, nothing to check\n");
+        
+    return failures ? 1 : 0;
+}
@@ -0,0 +1,277 @@
+//
+//  eval.c
+//  pod
+//
+//
+// Copyright (C) 2012 Scott McCoid, Gregoire Tronel, Jay Clark
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy of this software
+// and associated documentation files (the "Software"), to deal in the Software without restriction,
+// including without limitation the rights to use, copy, modify, merge, publish, distribute, sublicense,
+// and/or sell copies of the Software, and to permit persons to whom the Software is furnished to do so,
+// subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in all copies or substantial
+// portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR IMPLIED, INCLUDING BUT NOT
+// LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.
+// IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY,
+// WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE
+// SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+
+
+// Scores libpod against synthetic signals with known onsets: every detector setting below, on clicks, drum
+// hits and tone bursts, each clean and over noise beds at 20, 10 and 0 dB SNR. An onset counts as found if
+// an unclaimed detection is reported within 100 ms after it and before the next one starts; any other
+// detection is false. Latency is the time from the true onset to the report.
+//
+//     eval [-u upper_scale] [-a average_ms] [-p percentile] [-d seconds] [-i isa] [-o setting]
+//
+// Thresholds are automatic: upper_scale (2 by default) times the given percentile (95) of the flux over the
+// last average_ms (2000), or its mean for a percentile of -1. The kernels are the scalar ones unless -i names
+// another set, and the tools are built without floating point contraction, so the output should not depend
+// on the processor; reference/eval.txt is what it prints by default.
+
+#include "libpod.h"
+#include "signals.h"
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#define EVAL_BLOCK 64
+#define EVAL_TOLERANCE_MS 100.0f
+
+typedef struct _eval_setting
+{
+    const char* name;
+    int         window_size;
+    int         hop_size;
+    int         engine;
+    int         power;
+    int         resolutions[POD_MAX_RESOLUTIONS - 1];
+    
+} t_eval_setting;
+
+static const t_eval_setting settings[] =
+{
+    { "fft",            1024, 256, POD_ENGINE_FFT,  0, { 0, 0 } },
+    { "fft-power",      1024, 256, POD_ENGINE_FFT,  1, { 0, 0 } },
+    { "fft-hop64",      1024,  64, POD_ENGINE_FFT,  0, { 0, 0 } },
+    { "fft-512-256",    1024, 256, POD_ENGINE_FFT,  0, { 512, 256 } },
+    { "sdft-hop64",     1024,  64, POD_ENGINE_SDFT, 0, { 0, 0 } },
+    { "bank-hop64",     1024,  64, POD_ENGINE_BANK, 0, { 0, 0 } },
+    { "bank-hop32",     1024,  32, POD_ENGINE_BANK, 0, { 0, 0 } },
+};
+
+static const char* kinds[] = { "clicks", "drums", "tones" };
+static const float snrs[] = { INFINITY, 20.0f, 10.0f, 0.0f };
+
+#define NUM_SETTINGS (int)(sizeof(settings) / sizeof(settings[0]))
+#define NUM_KINDS (int)(sizeof(kinds) / sizeof(kinds[0]))
+#define NUM_SNRS (int)(sizeof(snrs) / sizeof(snrs[0]))
+
+// Reports from one run, in order
+typedef struct _eval_detections
+{
+    long long*  samples;
+    int         count;
+    int         capacity;
+    
+} t_eval_detections;
+
+typedef struct _eval_score
+{
+    int         onsets;
+    int         found;
+    int         detections;
+    float*      latencies;                      // ms, one per onset found
+    
+} t_eval_score;
+
+static void on_onset(void* user, const t_pod_onset* onset)
+{
+    t_eval_detections* d = (t_eval_detections *)user;
+    
+    if (d->count == d->capacity)
+    {
+        d->capacity = d->capacity ? 2 * d->capacity : 256;
+        d->samples = (long long *)realloc(d->samples, d->capacity * sizeof(long long));
+    }
+    d->samples[d->count++] = onset->sample;
+}
+
+static int run(const t_eval_setting* setting, const t_test_signal* signal, float upper_scale, float average_ms, float percentile,
+               t_eval_detections* detections)
+{
+    t_pod_config config;
+    t_pod* pod;
+    
+    pod_config_init(&config);
+    config.window_size = setting->window_size;
+    config.hop_size = setting->hop_size;
+    config.sample_rate = signal->sample_rate;
+    config.engine = setting->engine;
+    config.power = setting->power;
+    config.phase = 0;
+    config.average_ms = average_ms;
+    config.percentile = percentile;
+    memcpy(config.resolutions, setting->resolutions, sizeof(config.resolutions));
+    config.onset = on_onset;
+    config.user = detections;
+    
+    pod = pod_create(&config);
+    if (pod == NULL)
+        return -1;
+    pod_set_upper_threshold_scale(pod, upper_scale);
+    
+    detections->count = 0;
+    for (int i = 0; i + EVAL_BLOCK <= signal->length; i += EVAL_BLOCK)
+        pod_process_block(pod, signal->samples + i, EVAL_BLOCK);
+        
+    pod_destroy(pod);
+    return 0;
+}
+
+// Each onset claims the first detection in its window; both lists are in order
+static void score(const t_test_signal* signal, const t_eval_detections* detections, t_eval_score* s)
+{
+    long long tolerance = (long long)(EVAL_TOLERANCE_MS * 0.001f * signal->sample_rate);
+    int next = 0;
+    
+    for (int i = 0; i < signal->num_onsets; i++)
+    {
+        long long onset = signal->onsets[i];
+        long long end = onset + tolerance;
+        
+        if (i + 1 < signal->num_onsets && signal->onsets[i + 1] < end)
+            end = signal->onsets[i + 1];
+            
+        while (next < detections->count && detections->samples[next] < onset)
+            next++;
+            
+        if (next < detections->count && detections->samples[next] < end)
+        {
+            s->latencies[s->found++] = (detections->samples[next] - onset) * 1000.0f / signal->sample_rate;
+            next++;
+        }
+    }
+    
+    s->onsets += signal->num_onsets;
+    s->detections += detections->count;
+}
+
+static int compare_floats(const void* a, const void* b)
+{
+    float x = *(const float *)a, y = *(const float *)b;
+    
+    return x < y ? -1 : x > y;
+}
+
+static void print_score(const char* setting, const char* kind, const char* snr, t_eval_score* s)
+{
+    float precision = s->detections ? (float) s->found / s->detections : 0.0f;
+    float recall = s->onsets ? (float) s->found / s->onsets : 0.0f;
+    float f = precision + recall > 0.0f ? 2.0f * precision * recall / (precision + recall) : 0.0f;
+    
+    printf("%-12s %-6s %4s %6d %6d %6d   %5.3f %5.3f %5.3f", setting, kind, snr, s->onsets, s->found,
+           s->detections - s->found, precision, recall, f);
+           
+    if (s->found == 0)
+    {
+        printf("\n");
+        return;
+    }
+    
+    qsort(s->latencies, s->found, sizeof(float), compare_floats);
+    printf("   %6.1f %6.1f %6.1f %6.1f %6.1f\n", s->latencies[0], s->latencies[s->found / 10],
+           s->latencies[s->found / 2], s->latencies[s->found * 9 / 10], s->latencies[s->found - 1]);
+}
+
+int main(int argc, char** argv)
+{
+    float upper_scale = 2.0f, average_ms = 2000.0f, percentile = 95.0f, seconds = 30.0f;
+    const char* only = NULL;
+    int isa = POD_ISA_SCALAR, option;
+    t_test_signal signals[NUM_KINDS][NUM_SNRS];
+    t_eval_detections detections = { NULL, 0, 0 };
+    int max_onsets = 0;
+    
+    while ((option = getopt(argc, argv, "u:a:p:d:i:o:")) != -1)
+    {
+        switch (option)
+        {
+            case 'u': upper_scale = atof(optarg); break;
+            case 'a': average_ms = atof(optarg); break;
+            case 'p': percentile = atof(optarg); break;
+            case 'o': only = optarg; break;
+            case 'd': seconds = atof(optarg); break;
+            case 'i':
+                for (isa = 0; isa < POD_NUM_ISAS && strcmp(optarg, pod_cpu_name(isa)) != 0; isa++)
+                    ;
+                break;
+            default:
+                fprintf(stderr, "usage: eval [-u upper_scale] [-a average_ms] [-p percentile] [-d seconds] [-i isa] [-o setting]\n");
+                return 2;
+        }
+    }
+    
+    if (isa == POD_NUM_ISAS || pod_set_isa(isa) != 0)
+    {
+        fprintf(stderr, "eval: this processor or build has no such kernels\n");
+        return 1;
+    }
+    
+    for (int k = 0; k < NUM_KINDS; k++)
+        for (int n = 0; n < NUM_SNRS; n++)
+        {
+            if (test_signal_make(&signals[k][n], kinds[k], seconds, snrs[n], 44100.0f, 1 + k) != 0)
+                return 1;
+            if (signals[k][n].num_onsets > max_onsets)
+                max_onsets = signals[k][n].num_onsets;
+        }
+        
+    printf("# %g s per signal, upper scale %g, average %g ms, percentile %g, %s kernels, tolerance %g ms\n",
+           seconds, upper_scale, average_ms, percentile, pod_cpu_name(isa), EVAL_TOLERANCE_MS);
+    printf("# setting    signal  snr onsets  found  false   prec  rec   f        latency ms: min p10 median p90 max\n");
+    
+    for (int i = 0; i < NUM_SETTINGS; i++)
+    {
+        if (only && strcmp(only, settings[i].name) != 0)
+            continue;
+            
+        t_eval_score total = { 0, 0, 0, (float *)malloc(NUM_KINDS * NUM_SNRS * max_onsets * sizeof(float)) };
+        
+        for (int k = 0; k < NUM_KINDS; k++)
+            for (int n = 0; n < NUM_SNRS; n++)
+            {
+                t_eval_score one = { 0, 0, 0, (float *)malloc(max_onsets * sizeof(float)) };
+                char snr[8];
+                
+                if (run(&settings[i], &signals[k][n], upper_scale, average_ms, percentile, &detections) != 0)
+                    return 1;
+                    
+                score(&signals[k][n], &detections, &one);
+                memcpy(total.latencies + total.found, one.latencies, one.found * sizeof(float));
+                total.onsets += one.onsets;
+                total.found += one.found;
+                total.detections += one.detections;
+                
+                snprintf(snr, sizeof(snr), isinf(snrs[n]) ? "-" : "%g", snrs[n]);
+                print_score(settings[i].name, kinds[k], snr, &one);
+                free(one.latencies);
+            }
+            
+        print_score(settings[i].name, "all", "", &total);
+        printf("\n");
+        free(total.latencies);
+    }
+    
+    for (int k = 0; k < NUM_KINDS; k++)
+        for (int n = 0; n < NUM_SNRS; n++)
+            test_signal_free(&signals[k][n]);
+    free(detections.samples);
+    return 0;
+}
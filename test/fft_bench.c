@@ -0,0 +1,162 @@
+//
+//  fft_bench.c
+//  pod
+//
+//
+// Copyright (C) 2012 Scott McCoid, Gregoire Tronel, Jay Clark
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy of this software
+// and associated documentation files (the "Software"), to deal in the Software without restriction,
+// including without limitation the rights to use, copy, modify, merge, publish, distribute, sublicense,
+// and/or sell copies of the Software, and to permit persons to whom the Software is furnished to do so,
+// subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in all copies or substantial
+// portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR IMPLIED, INCLUDING BUT NOT
+// LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.
+// IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY,
+// WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE
+// SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+
+
+// Compares the fft backend this build was made with against a double precision reference, and times it,
+// for every size libpod can ask for:
+//
+//     fft_bench [-r repeats]
+//
+// Per size: the fastest of five batches of repeated transforms, in ns per transform and per input sample,
+// and the largest difference from the reference in any bin, relative to the largest bin. Build with FFT=fftw
+// or FFT=pffft in the Makefile to get the same table for those backends; make backends runs all three.
+
+#include "pod_fft.h"
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+
+#define BENCH_MIN_SIZE 64
+#define BENCH_MAX_SIZE 8192
+#define BENCH_BATCHES 5
+
+static double now_ns(void)
+{
+    struct timespec t;
+    
+    clock_gettime(CLOCK_MONOTONIC, &t);
+    return t.tv_sec * 1e9 + t.tv_nsec;
+}
+
+// Recursive radix-2 complex transform in double, only ever used as the reference
+static void reference_fft(double* re, double* im, int n)
+{
+    double *even_re, *even_im, *odd_re, *odd_im;
+    
+    if (n == 1)
+        return;
+        
+    even_re = (double *)malloc(n / 2 * sizeof(double));
+    even_im = (double *)malloc(n / 2 * sizeof(double));
+    odd_re = (double *)malloc(n / 2 * sizeof(double));
+    odd_im = (double *)malloc(n / 2 * sizeof(double));
+    
+    for (int i = 0; i < n / 2; i++)
+    {
+        even_re[i] = re[2 * i];
+        even_im[i] = im[2 * i];
+        odd_re[i] = re[2 * i + 1];
+        odd_im[i] = im[2 * i + 1];
+    }
+    reference_fft(even_re, even_im, n / 2);
+    reference_fft(odd_re, odd_im, n / 2);
+    
+    for (int k = 0; k < n / 2; k++)
+    {
+        double c = cos(-2.0 * M_PI * k / n), s = sin(-2.0 * M_PI * k / n);
+        double t_re = c * odd_re[k] - s * odd_im[k];
+        double t_im = c * odd_im[k] + s * odd_re[k];
+        
+        re[k] = even_re[k] + t_re;
+        im[k] = even_im[k] + t_im;
+        re[k + n / 2] = even_re[k] - t_re;
+        im[k + n / 2] = even_im[k] - t_im;
+    }
+    
+    free(even_re);
+    free(even_im);
+    free(odd_re);
+    free(odd_im);
+}
+
+int main(int argc, char** argv)
+{
+    int repeats = 2000, option;
+    unsigned int state = 1;
+    
+    while ((option = getopt(argc, argv, "r:")) != -1)
+    {
+        if (option != 'r' || (repeats = atoi(optarg)) < 1)
+        {
+            fprintf(stderr, "usage: fft_bench [-r repeats]\n");
+            return 2;
+        }
+    }
+    
+    printf("# fft: %s\n", pod_fft_backend_name());
+    printf("# size  ns/transform  ns/sample  error\n");
+    
+    for (int size = BENCH_MIN_SIZE; size <= BENCH_MAX_SIZE; size *= 2)
+    {
+        t_pod_fft_plan* plan = pod_fft_plan_acquire(size);
+        float* in = pod_fft_alloc(size);
+        float* out = pod_fft_alloc(size + 2);
+        float* work = pod_fft_alloc(size);
+        double* re = (double *)malloc(size * sizeof(double));
+        double* im = (double *)calloc(size, sizeof(double));
+        double best = 1e300, error = 0.0, largest = 0.0;
+        int count = repeats * 1024 / size > 0 ? repeats * 1024 / size : 1;
+        
+        if (plan == NULL || in == NULL || out == NULL || work == NULL)
+        {
+            fprintf(stderr, "fft_bench: out of memory at size %d\n", size);
+            return 1;
+        }
+        
+        for (int i = 0; i < size; i++)
+        {
+            state = state * 1664525u + 1013904223u;
+            in[i] = (state >> 8) * (2.0f / 16777216.0f) - 1.0f;
+            re[i] = in[i];
+        }
+        
+        pod_fft_forward(plan, in, out, work);
+        reference_fft(re, im, size);
+        for (int k = 0; k <= size / 2; k++)
+            largest = fmax(largest, hypot(re[k], im[k]));
+        for (int k = 0; k <= size / 2; k++)
+            error = fmax(error, hypot(out[2 * k] - re[k], out[2 * k + 1] - im[k]));
+            
+        for (int batch = 0; batch < BENCH_BATCHES; batch++)
+        {
+            double start = now_ns();
+            
+            for (int i = 0; i < count; i++)
+                pod_fft_forward(plan, in, out, work);
+            best = fmin(best, (now_ns() - start) / count);
+        }
+        
+        printf("%6d  %12.1f  %9.3f  %.2e\n", size, best, best / size, error / largest);
+        
+        free(re);
+        free(im);
+        pod_fft_free(in);
+        pod_fft_free(out);
+        pod_fft_free(work);
+        pod_fft_plan_release(plan);
+    }
+    
+    return 0;
+}
@@ -0,0 +1,504 @@
+//
+//  pd_host.c
+//  pod
+//
+//
+// Copyright (C) 2012 Scott McCoid, Gregoire Tronel, Jay Clark
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy of this software
+// and associated documentation files (the "Software"), to deal in the Software without restriction,
+// including without limitation the rights to use, copy, modify, merge, publish, distribute, sublicense,
+// and/or sell copies of the Software, and to permit persons to whom the Software is furnished to do so,
+// subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in all copies or substantial
+// portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR IMPLIED, INCLUDING BUT NOT
+// LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.
+// IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY,
+// WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE
+// SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+
+
+// A headless stand-in for Pd: just the parts of m_pd.h that pod~ uses, enough to set up the external, create
+// one object, send it messages and run its perform routine over a WAV file or a synthetic signal. Every
+// outlet message is printed with the input position it came from, so runs can be compared without Pd.
+//
+//     pd_host [-w window] [-H hop] [-c channels] [-l latency] [-b block] [-r rate] [-f] [-t]
+//             [-s clicks|drums|tones] [-d seconds] [-n snr_db] [-S seed] [-m "[@sample|@end] message"]... [file.wav]
+//
+// The first four options are pod~'s creation arguments. Without a file the input is the synthetic signal -s,
+// see signals.h. Messages are sent before the first block, before the block that starts at @sample, or after
+// the last block with @end, for example -m "upper_scale 3" -m "@88200 hop 128" -m "@end average".
+//
+// Output on stdout, one line per event, where <sample> is the count of samples per channel up to the end of
+// the block the event came from:
+//     <sample> onset <channel> <peak>
+//     <sample> flux <channel> <flux>           with -f
+//     <sample> truth                           with -t, each of the synthetic signal's known onsets
+// Console posts and errors go to stderr.
+
+#include "m_pd.h"
+#include "signals.h"
+#include <math.h>
+#include <stdarg.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#define HOST_MAX_METHODS 64
+#define HOST_MAX_OUTLETS 8
+#define HOST_MAX_CLOCKS 8
+#define HOST_MAX_MESSAGES 64
+#define HOST_MAX_ATOMS 8
+
+void pod_tilde_setup(void);
+
+#pragma mark - Classes and Symbols -
+
+struct _class
+{
+    size_t          size;
+    t_newmethod     new_method;
+    t_method        free_method;
+    int             num_methods;
+    t_symbol*       selectors[HOST_MAX_METHODS];
+    t_method        methods[HOST_MAX_METHODS];
+    t_atomtype      types[HOST_MAX_METHODS];    // A_NULL, A_FLOAT, A_SYMBOL or A_GIMME
+    
+};
+
+struct _outlet
+{
+    int             index;                      // left to right
+    
+};
+
+struct _clock
+{
+    void*           owner;
+    t_method        fn;
+    int             pending;
+    
+};
+
+t_symbol s_bang = { "bang", 0, 0 };
+t_symbol s_float = { "float", 0, 0 };
+t_symbol s_list = { "list", 0, 0 };
+t_symbol s_signal = { "signal", 0, 0 };
+t_symbol s_ = { "", 0, 0 };
+
+static struct _class host_class;
+static t_symbol* host_symbols;
+static struct _outlet host_outlets[HOST_MAX_OUTLETS];
+static int host_num_outlets;
+static struct _clock host_clocks[HOST_MAX_CLOCKS];
+static int host_num_clocks;
+
+static t_perfroutine host_perform;
+static t_int* host_args;
+static float host_sample_rate = 44100.0f;
+static long long host_position;                 // samples per channel up to the end of the current block
+static int host_print_flux;
+static int host_onset_channel;
+
+t_symbol* gensym(const char* s)
+{
+    t_symbol* symbol;
+    
+    for (symbol = host_symbols; symbol; symbol = symbol->s_next)
+        if (strcmp(symbol->s_name, s) == 0)
+            return symbol;
+            
+    symbol = (t_symbol *)calloc(1, sizeof(t_symbol));
+    symbol->s_name = strdup(s);
+    symbol->s_next = host_symbols;
+    host_symbols = symbol;
+    return symbol;
+}
+
+t_class* class_new(t_symbol* name, t_newmethod newmethod, t_method freemethod, size_t size, int flags, t_atomtype arg1, ...)
+{
+    host_class.size = size;
+    host_class.new_method = newmethod;
+    host_class.free_method = freemethod;
+    return &host_class;
+}
+
+void class_addmethod(t_class* c, t_method fn, t_symbol* sel, t_atomtype arg1, ...)
+{
+    if (c->num_methods == HOST_MAX_METHODS)
+        return;
+        
+    c->selectors[c->num_methods] = sel;
+    c->methods[c->num_methods] = fn;
+    c->types[c->num_methods] = arg1;
+    c->num_methods++;
+}
+
+void class_domainsignalin(t_class* c, int onset)
+{
+}
+
+t_pd* pd_new(t_class* cls)
+{
+    t_pd* x = (t_pd *)calloc(1, cls->size);
+    
+    *x = cls;
+    return x;
+}
+
+void pd_free(t_pd* x)
+{
+    if ((*x)->free_method)
+        ((void (*)(t_pd *))(*x)->free_method)(x);
+    free(x);
+}
+
+#pragma mark - Inlets, Outlets and Atoms -
+
+t_inlet* inlet_new(t_object* owner, t_pd* dest, t_symbol* s1, t_symbol* s2)
+{
+    return NULL;
+}
+
+t_outlet* outlet_new(t_object* owner, t_symbol* s)
+{
+    if (host_num_outlets == HOST_MAX_OUTLETS)
+        return NULL;
+        
+    host_outlets[host_num_outlets].index = host_num_outlets;
+    return &host_outlets[host_num_outlets++];
+}
+
+// pod~'s outlets are bang, peak, flux and, with several channels, the channel of the onset that follows
+void outlet_bang(t_outlet* x)
+{
+}
+
+void outlet_float(t_outlet* x, t_float f)
+{
+    switch (x->index)
+    {
+        case 1:
+            printf("%lld onset %d %g\n", host_position, host_onset_channel, f);
+            break;
+        case 2:
+            if (host_print_flux)
+                printf("%lld flux 0 %g\n", host_position, f);
+            break;
+        case 3:
+            host_onset_channel = (int) f;
+            break;
+    }
+}
+
+void outlet_list(t_outlet* x, t_symbol* s, int argc, t_atom* argv)
+{
+    if (x->index == 2 && host_print_flux && argc == 2)
+        printf("%lld flux %d %g\n", host_position, (int) atom_getfloat(argv), atom_getfloat(argv + 1));
+}
+
+t_float atom_getfloat(t_atom* a)
+{
+    return a->a_type == A_FLOAT ? a->a_w.w_float : 0;
+}
+
+t_symbol* atom_getsymbol(t_atom* a)
+{
+    return a->a_type == A_SYMBOL ? a->a_w.w_symbol : &s_;
+}
+
+#pragma mark - System -
+
+void post(const char* fmt, ...)
+{
+    va_list args;
+    
+    va_start(args, fmt);
+    vfprintf(stderr, fmt, args);
+    fputc('\n', stderr);
+    va_end(args);
+}
+
+void pd_error(void* object, const char* fmt, ...)
+{
+    va_list args;
+    
+    va_start(args, fmt);
+    fputs("error: ", stderr);
+    vfprintf(stderr, fmt, args);
+    fputc('\n', stderr);
+    va_end(args);
+}
+
+void* getbytes(size_t nbytes)
+{
+    return calloc(1, nbytes > 0 ? nbytes : 1);
+}
+
+void freebytes(void* x, size_t nbytes)
+{
+    free(x);
+}
+
+t_float sys_getsr(void)
+{
+    return host_sample_rate;
+}
+
+t_clock* clock_new(void* owner, t_method fn)
+{
+    if (host_num_clocks == HOST_MAX_CLOCKS)
+        return NULL;
+        
+    host_clocks[host_num_clocks].owner = owner;
+    host_clocks[host_num_clocks].fn = fn;
+    return &host_clocks[host_num_clocks++];
+}
+
+void clock_delay(t_clock* x, double delaytime)
+{
+    x->pending = 1;
+}
+
+void clock_free(t_clock* x)
+{
+    x->pending = 0;
+}
+
+// Clocks fire between blocks, on the same thread, the way Pd's scheduler runs them
+static void host_run_clocks(void)
+{
+    for (int i = 0; i < host_num_clocks; i++)
+        if (host_clocks[i].pending)
+        {
+            host_clocks[i].pending = 0;
+            ((void (*)(void *))host_clocks[i].fn)(host_clocks[i].owner);
+        }
+}
+
+// The chain holds one perform routine; Pd passes it a pointer to its own entry, arguments following
+void dsp_addv(t_perfroutine f, int n, t_int* vec)
+{
+    free(host_args);
+    host_args = (t_int *)malloc((n + 1) * sizeof(t_int));
+    host_args[0] = (t_int) f;
+    memcpy(host_args + 1, vec, n * sizeof(t_int));
+    host_perform = f;
+}
+
+void dsp_add(t_perfroutine f, int n, ...)
+{
+    t_int vec[16];
+    va_list args;
+    
+    va_start(args, n);
+    for (int i = 0; i < n && i < 16; i++)
+        vec[i] = va_arg(args, t_int);
+    va_end(args);
+    dsp_addv(f, n < 16 ? n : 16, vec);
+}
+
+#pragma mark - Messages -
+
+typedef struct _host_message
+{
+    long long       at;                         // -1 before the first block, LLONG_MAX after the last
+    t_symbol*       selector;
+    int             argc;
+    t_atom          argv[HOST_MAX_ATOMS];
+    
+} t_host_message;
+
+static int host_parse_message(t_host_message* message, const char* text)
+{
+    char buffer[256];
+    char* token;
+    char* end;
+    
+    snprintf(buffer, sizeof(buffer), "%s", text);
+    message->at = -1;
+    message->selector = NULL;
+    message->argc = 0;
+    
+    for (token = strtok(buffer, " \t"); token; token = strtok(NULL, " \t"))
+    {
+        double value = strtod(token, &end);
+        
+        if (token[0] == '@' && message->selector == NULL)
+            message->at = strcmp(token, "@end") == 0 ? 0x7fffffffffffffffLL : atoll(token + 1);
+        else if (message->selector == NULL)
+            message->selector = gensym(token);
+        else if (message->argc < HOST_MAX_ATOMS)
+        {
+            // SETFLOAT and SETSYMBOL name their atom twice
+            t_atom* atom = &message->argv[message->argc++];
+            
+            if (*end == '\0')
+                SETFLOAT(atom, value);
+            else
+                SETSYMBOL(atom, gensym(token));
+        }
+    }
+    
+    return message->selector ? 0 : -1;
+}
+
+static void host_send(t_pd* object, t_host_message* message)
+{
+    int i;
+    t_method fn;
+    
+    for (i = 0; i < host_class.num_methods; i++)
+        if (host_class.selectors[i] == message->selector)
+            break;
+            
+    if (i == host_class.num_methods)
+    {
+        fprintf(stderr, "error: pod~: no method for '%s'\n", message->selector->s_name);
+        return;
+    }
+    
+    fn = host_class.methods[i];
+    switch (host_class.types[i])
+    {
+        case A_FLOAT:
+            ((void (*)(t_pd *, t_float))fn)(object, message->argc ? atom_getfloat(message->argv) : 0);
+            break;
+        case A_SYMBOL:
+            ((void (*)(t_pd *, t_symbol *))fn)(object, message->argc ? atom_getsymbol(message->argv) : &s_);
+            break;
+        case A_GIMME:
+            ((void (*)(t_pd *, t_symbol *, int, t_atom *))fn)(object, message->selector, message->argc, message->argv);
+            break;
+        default:
+            ((void (*)(t_pd *))fn)(object);
+            break;
+    }
+    host_run_clocks();
+}
+
+#pragma mark - Main -
+
+static void usage(void)
+{
+    fprintf(stderr, "usage: pd_host [-w window] [-H hop] [-c channels] [-l latency] [-b block] [-r rate] [-f] [-t]\n"
+                    "               [-s clicks|drums|tones] [-d seconds] [-n snr_db] [-S seed]\n"
+                    "               [-m \"[@sample|@end] message\"]... [file.wav]\n");
+    exit(2);
+}
+
+int main(int argc, char** argv)
+{
+    float window = 0, hop = 0, channels = 0, latency = 0;
+    int block = 64, print_truth = 0, num_messages = 0, option;
+    const char* kind = "drums";
+    float seconds = 10.0f, snr_db = INFINITY;
+    unsigned int seed = 1;
+    t_host_message messages[HOST_MAX_MESSAGES];
+    t_test_signal signal;
+    t_signal* signals;
+    t_signal** sp;
+    t_sample* buffers;
+    t_pd* object;
+    t_host_message dsp;
+    
+    while ((option = getopt(argc, argv, "w:H:c:l:b:r:fts:d:n:S:m:")) != -1)
+    {
+        switch (option)
+        {
+            case 'w': window = atof(optarg); break;
+            case 'H': hop = atof(optarg); break;
+            case 'c': channels = atof(optarg); break;
+            case 'l': latency = atof(optarg); break;
+            case 'b': block = atoi(optarg); break;
+            case 'r': host_sample_rate = atof(optarg); break;
+            case 'f': host_print_flux = 1; break;
+            case 't': print_truth = 1; break;
+            case 's': kind = optarg; break;
+            case 'd': seconds = atof(optarg); break;
+            case 'n': snr_db = strcmp(optarg, "inf") == 0 ? INFINITY : atof(optarg); break;
+            case 'S': seed = (unsigned int) strtoul(optarg, NULL, 0); break;
+            case 'm':
+                if (num_messages == HOST_MAX_MESSAGES || host_parse_message(&messages[num_messages++], optarg) != 0)
+                    usage();
+                break;
+            default:
+                usage();
+        }
+    }
+    
+    if (block < 1)
+        usage();
+        
+    if (optind < argc ? test_signal_read_wav(&signal, argv[optind]) != 0
+                      : test_signal_make(&signal, kind, seconds, snr_db, host_sample_rate, seed) != 0)
+    {
+        fprintf(stderr, "pd_host: could not %s %s\n", optind < argc ? "read" : "make", optind < argc ? argv[optind] : kind);
+        return 1;
+    }
+    
+    // A file sets the rate and, unless -c says otherwise, the channels
+    host_sample_rate = signal.sample_rate;
+    if (channels < 1)
+        channels = signal.channels;
+        
+    pod_tilde_setup();
+    object = (t_pd *)((void *(*)(t_floatarg, t_floatarg, t_floatarg, t_floatarg))host_class.new_method)(window, hop, channels, latency);
+    host_run_clocks();
+    if (object == NULL)
+        return 1;
+        
+    signals = (t_signal *)calloc((size_t) channels, sizeof(t_signal));
+    sp = (t_signal **)calloc((size_t) channels, sizeof(t_signal *));
+    buffers = (t_sample *)calloc((size_t) channels * block, sizeof(t_sample));
+    for (int c = 0; c < (int) channels; c++)
+    {
+        signals[c].s_n = block;
+        signals[c].s_sr = host_sample_rate;
+        signals[c].s_vec = buffers + (size_t) c * block;
+        sp[c] = &signals[c];
+    }
+    
+    // dsp is the method registered with no arguments that takes the signal vectors
+    host_parse_message(&dsp, "dsp");
+    for (int i = 0; i < host_class.num_methods; i++)
+        if (host_class.selectors[i] == dsp.selector)
+            ((void (*)(t_pd *, t_signal **))host_class.methods[i])(object, sp);
+            
+    if (print_truth)
+        for (int i = 0; i < signal.num_onsets; i++)
+            printf("%lld truth\n", signal.onsets[i]);
+            
+    for (long long start = 0; start < signal.length || start == 0; start += block)
+    {
+        for (int i = 0; i < num_messages; i++)
+            if (messages[i].at < start + block && messages[i].at >= (start == 0 ? -1 : start))
+                host_send(object, &messages[i]);
+                
+        // The last block is padded with silence; channels beyond the file's repeat its channels
+        for (int c = 0; c < (int) channels; c++)
+            for (int i = 0; i < block; i++)
+                buffers[(size_t) c * block + i] = start + i < signal.length
+                    ? signal.samples[(size_t)(c % signal.channels) * signal.length + start + i] : 0.0f;
+                    
+        host_position = start + block;
+        host_perform(host_args);
+        host_run_clocks();
+    }
+    
+    for (int i = 0; i < num_messages; i++)
+        if (messages[i].at == 0x7fffffffffffffffLL)
+            host_send(object, &messages[i]);
+            
+    pd_free(object);
+    free(host_args);
+    free(buffers);
+    free(sp);
+    free(signals);
+    test_signal_free(&signal);
+    return 0;
+}
@@ -0,0 +1,260 @@
+//
+//  signals.c
+//  pod
+//
+//
+// Copyright (C) 2012 Scott McCoid, Gregoire Tronel, Jay Clark
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy of this software
+// and associated documentation files (the "Software"), to deal in the Software without restriction,
+// including without limitation the rights to use, copy, modify, merge, publish, distribute, sublicense,
+// and/or sell copies of the Software, and to permit persons to whom the Software is furnished to do so,
+// subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in all copies or substantial
+// portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR IMPLIED, INCLUDING BUT NOT
+// LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.
+// IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY,
+// WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE
+// SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+
+
+#include "signals.h"
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#ifndef M_PI
+#define M_PI 3.14159265358979323846
+#endif
+
+#pragma mark - Synthetic -
+
+// Numerical Recipes' LCG: the same sequence on every platform, unlike rand()
+static float uniform(unsigned int* state)
+{
+    *state = *state * 1664525u + 1013904223u;
+    return (*state >> 8) * (1.0f / 16777216.0f);
+}
+
+static float noise(unsigned int* state)
+{
+    return 2.0f * uniform(state) - 1.0f;
+}
+
+static void add_click(float* out, int length, float sample_rate, float level, unsigned int* state)
+{
+    int n = (int)(0.005f * sample_rate);
+    
+    for (int i = 0; i < n && i < length; i++)
+        out[i] += level * noise(state) * expf(-i / (0.001f * sample_rate));
+}
+
+static void add_drum(float* out, int length, float sample_rate, float level, int hit, unsigned int* state)
+{
+    int n = (int)(0.3f * sample_rate);
+    double phase = 0.0;
+    float last = 0.0f;
+    
+    for (int i = 0; i < n && i < length; i++)
+    {
+        float t = i / sample_rate;
+        float white = noise(state);
+        
+        switch (hit)
+        {
+            case 0:                             // kick: a sine falling from 150 to 50 Hz
+                phase += 2.0 * M_PI * (50.0 + 100.0 * exp(-t / 0.03)) / sample_rate;
+                out[i] += level * (float) sin(phase) * expf(-t / 0.15f);
+                break;
+            case 1:                             // snare: noise over a 180 Hz tone
+                out[i] += level * (0.6f * white * expf(-t / 0.06f) + 0.4f * sinf(2.0f * M_PI * 180.0f * t) * expf(-t / 0.08f));
+                break;
+            default:                            // hat: differenced noise, mostly above 5 kHz
+                out[i] += level * 0.5f * (white - last) * expf(-t / 0.02f);
+                break;
+        }
+        last = white;
+    }
+}
+
+static void add_tone(float* out, int length, float sample_rate, float level, unsigned int* state)
+{
+    float frequency = 200.0f * powf(2.0f, uniform(state) * 4.32f);
+    int attack = (int)(0.005f * sample_rate);
+    int hold = (int)((0.1f + 0.15f * uniform(state)) * sample_rate);
+    int release = (int)(0.03f * sample_rate);
+    
+    for (int i = 0; i < attack + hold + release && i < length; i++)
+    {
+        float envelope = i < attack ? (float) i / attack : i < attack + hold ? 1.0f : 1.0f - (float)(i - attack - hold) / release;
+        
+        out[i] += level * envelope * sinf(2.0f * M_PI * frequency * i / sample_rate);
+    }
+}
+
+int test_signal_make(t_test_signal* signal, const char* kind, float seconds, float snr_db, float sample_rate, unsigned int seed)
+{
+    unsigned int state = seed;
+    int type;
+    double power = 0.0;
+    long long start;
+    
+    if (strcmp(kind, "clicks") == 0)
+        type = 0;
+    else if (strcmp(kind, "drums") == 0)
+        type = 1;
+    else if (strcmp(kind, "tones") == 0)
+        type = 2;
+    else
+        return -1;
+        
+    memset(signal, 0, sizeof(t_test_signal));
+    signal->channels = 1;
+    signal->sample_rate = sample_rate;
+    signal->length = (int)(seconds * sample_rate);
+    signal->samples = (float *)calloc(signal->length > 0 ? signal->length : 1, sizeof(float));
+    signal->onsets = (long long *)malloc((size_t)(seconds / 0.35f + 1) * sizeof(long long));
+    
+    if (signal->samples == NULL || signal->onsets == NULL)
+    {
+        test_signal_free(signal);
+        return -1;
+    }
+    
+    // The first event leaves half a second for the automatic thresholds to settle, the last one room to ring
+    for (start = (long long)(0.5f * sample_rate); start + 0.4f * sample_rate < signal->length;
+         start += (long long)((0.35f + 0.35f * uniform(&state)) * sample_rate))
+    {
+        float level = powf(10.0f, -0.5f * uniform(&state));
+        float* out = signal->samples + start;
+        int room = signal->length - (int) start;
+        
+        if (type == 0)
+            add_click(out, room, sample_rate, level, &state);
+        else if (type == 1)
+            add_drum(out, room, sample_rate, level, signal->num_onsets % 3, &state);
+        else
+            add_tone(out, room, sample_rate, level, &state);
+            
+        signal->onsets[signal->num_onsets++] = start;
+    }
+    
+    if (isinf(snr_db))
+        return 0;
+        
+    for (int i = 0; i < signal->length; i++)
+        power += (double) signal->samples[i] * signal->samples[i];
+    power /= signal->length > 0 ? signal->length : 1;
+    
+    // uniform noise on [-1, 1) has a power of 1/3
+    float scale = (float) sqrt(3.0 * power / pow(10.0, snr_db / 10.0));
+    
+    for (int i = 0; i < signal->length; i++)
+        signal->samples[i] += scale * noise(&state);
+        
+    return 0;
+}
+
+#pragma mark - WAV -
+
+static unsigned int read_le(const unsigned char* bytes, int count)
+{
+    unsigned int value = 0;
+    
+    for (int i = count - 1; i >= 0; i--)
+        value = (value << 8) | bytes[i];
+    return value;
+}
+
+// PCM at 16, 24 or 32 bits, or 32 bit float, plain or extensible
+int test_signal_read_wav(t_test_signal* signal, const char* path)
+{
+    FILE* file = fopen(path, "rb");
+    unsigned char header[12], chunk[8], format[40];
+    int tag = 0, bits = 0, found_format = 0;
+    unsigned int size;
+    
+    memset(signal, 0, sizeof(t_test_signal));
+    if (file == NULL)
+        return -1;
+        
+    if (fread(header, 1, 12, file) != 12 || memcmp(header, "RIFF", 4) != 0 || memcmp(header + 8, "WAVE", 4) != 0)
+        goto fail;
+        
+    while (fread(chunk, 1, 8, file) == 8)
+    {
+        size = read_le(chunk + 4, 4);
+        
+        if (memcmp(chunk, "fmt ", 4) == 0)
+        {
+            if (size < 16 || fread(format, 1, size < sizeof(format) ? size : sizeof(format), file) < 16)
+                goto fail;
+            if (size > sizeof(format))
+                fseek(file, size - sizeof(format), SEEK_CUR);
+                
+            tag = read_le(format, 2);
+            signal->channels = read_le(format + 2, 2);
+            signal->sample_rate = read_le(format + 4, 4);
+            bits = read_le(format + 14, 2);
+            
+            // WAVE_FORMAT_EXTENSIBLE keeps the real tag at the start of its sub format
+            if (tag == 0xFFFE && size >= 26)
+                tag = read_le(format + 24, 2);
+            found_format = 1;
+        }
+        else if (memcmp(chunk, "data", 4) == 0 && found_format)
+        {
+            int bytes = bits / 8;
+            unsigned char* data;
+            
+            if (signal->channels < 1 || !((tag == 1 && (bits == 16 || bits == 24 || bits == 32)) || (tag == 3 && bits == 32)))
+                goto fail;
+                
+            signal->length = size / (bytes * signal->channels);
+            data = (unsigned char *)malloc(size > 0 ? size : 1);
+            signal->samples = (float *)malloc((size_t) signal->length * signal->channels * sizeof(float) + 1);
+            if (data == NULL || signal->samples == NULL || fread(data, 1, size, file) != size)
+            {
+                free(data);
+                goto fail;
+            }
+            
+            for (int i = 0; i < signal->length; i++)
+                for (int c = 0; c < signal->channels; c++)
+                {
+                    const unsigned char* sample = data + ((size_t) i * signal->channels + c) * bytes;
+                    unsigned int word = read_le(sample, bytes) << (32 - bits);
+                    float value;
+                    
+                    if (tag == 3)
+                        memcpy(&value, &word, sizeof(float));
+                    else
+                        value = (int) word / 2147483648.0f;
+                        
+                    signal->samples[(size_t) c * signal->length + i] = value;
+                }
+                
+            free(data);
+            fclose(file);
+            return 0;
+        }
+        else
+            fseek(file, size + (size & 1), SEEK_CUR);
+    }
+    
+fail:
+    fclose(file);
+    test_signal_free(signal);
+    return -1;
+}
+
+void test_signal_free(t_test_signal* signal)
+{
+    free(signal->samples);
+    free(signal->onsets);
+    memset(signal, 0, sizeof(t_test_signal));
+}
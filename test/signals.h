@@ -0,0 +1,54 @@
+//
+//  signals.h
+//  pod
+//
+//
+// Copyright (C) 2012 Scott McCoid, Gregoire Tronel, Jay Clark
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy of this software
+// and associated documentation files (the "Software"), to deal in the Software without restriction,
+// including without limitation the rights to use, copy, modify, merge, publish, distribute, sublicense,
+// and/or sell copies of the Software, and to permit persons to whom the Software is furnished to do so,
+// subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in all copies or substantial
+// portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR IMPLIED, INCLUDING BUT NOT
+// LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.
+// IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY,
+// WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE
+// SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+
+
+// Test inputs for the tools in this directory: WAV files, and synthetic signals whose onsets are known to
+// the sample. Every synthetic signal comes from its own generator seeded by the caller, so the same
+// arguments give the same samples on every machine and every run.
+//
+// clicks  - 1 ms decaying noise bursts
+// drums   - kick, snare and hat like hits in turn: a falling sine, noise over a tone, differenced noise
+// tones   - sine bursts from 200 Hz to 4 kHz with a 5 ms attack, held 100 - 250 ms
+//
+// Events start 350 - 700 ms apart at levels between -10 and 0 dB. The noise bed is white, at snr_db below
+// the power of the whole signal without it; pass INFINITY for none.
+
+#ifndef TEST_SIGNALS_H
+#define TEST_SIGNALS_H
+
+typedef struct _test_signal
+{
+    int         channels;
+    int         length;                         // samples per channel
+    float       sample_rate;
+    float*      samples;                        // channel after channel, length each
+    long long*  onsets;                         // first sample of every event, synthetic signals only
+    int         num_onsets;
+    
+} t_test_signal;
+
+// Each returns 0, or -1 if the kind is unknown, the file could not be read or memory ran out
+int test_signal_make(t_test_signal* signal, const char* kind, float seconds, float snr_db, float sample_rate, unsigned int seed);
+int test_signal_read_wav(t_test_signal* signal, const char* path);
+void test_signal_free(t_test_signal* signal);
+
+#endif
@@ -0,0 +1,332 @@
+//
+//  stress.c
+//  pod
+//
+//
+// Copyright (C) 2012 Scott McCoid, Gregoire Tronel, Jay Clark
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy of this software
+// and associated documentation files (the "Software"), to deal in the Software without restriction,
+// including without limitation the rights to use, copy, modify, merge, publish, distribute, sublicense,
+// and/or sell copies of the Software, and to permit persons to whom the Software is furnished to do so,
+// subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in all copies or substantial
+// portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR IMPLIED, INCLUDING BUT NOT
+// LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.
+// IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY,
+// WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE
+// SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+
+
+// Runs many detectors with different settings side by side, the way a patch full of pod~ objects would,
+// and checks that every one of them reports exactly what it reports when it runs alone. Together the
+// detectors share window and filterbank tables, fft plans and the kernel table, and the ones with a latency
+// share the pool of worker threads. Onsets and flux values are compared bit for bit, along with their
+// sample stamps.
+//
+//     stress [-d seconds] [-b block] [-t threads]
+//
+// The side by side run goes block by block through every detector on one thread, as Pd does, and then again
+// setting the kernel set every block, which takes back the frames out on the workers without changing what
+// they report.
+// With -t the detectors are also split between that many threads, each running its share over the whole
+// signal at once. Every run ends by setting the kernel set too, which reports the frames still out on the
+// workers. Exits with 1 if any detector's events differ. make tsan runs it under ThreadSanitizer.
+
+#include "libpod.h"
+#include "signals.h"
+#include <math.h>
+#include <pthread.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#define STRESS_MAX_CHANNELS 3
+
+typedef struct _stress_setting
+{
+    int         window_size;
+    int         hop_size;
+    int         channels;
+    int         latency;
+    int         spread;
+    int         engine;
+    int         power;
+    int         phase;
+    int         resolutions[POD_MAX_RESOLUTIONS - 1];
+    
+} t_stress_setting;
+
+static const t_stress_setting settings[] =
+{
+    //  window  hop  ch lat spread engine           power phase resolutions
+    {   1024,   256, 1, 0,  0,     POD_ENGINE_FFT,  0,    0,    { 0, 0 } },
+    {   1024,   256, 1, 0,  0,     POD_ENGINE_FFT,  0,    128,  { 0, 0 } },
+    {   1024,   128, 2, 0,  0,     POD_ENGINE_FFT,  1,    64,   { 0, 0 } },
+    {    256,    32, 1, 0,  0,     POD_ENGINE_FFT,  0,    0,    { 0, 0 } },
+    {    512,    64, 3, 0,  0,     POD_ENGINE_FFT,  0,    0,    { 0, 0 } },
+    {   2048,   512, 1, 0,  0,     POD_ENGINE_FFT,  0,    320,  { 0, 0 } },
+    {   4096,  1024, 2, 0,  0,     POD_ENGINE_FFT,  0,    0,    { 0, 0 } },
+    {   8192,   256, 1, 0,  0,     POD_ENGINE_FFT,  0,    192,  { 0, 0 } },
+    {   1024,   256, 1, 2,  0,     POD_ENGINE_FFT,  0,    0,    { 0, 0 } },
+    {   2048,   128, 3, 4,  0,     POD_ENGINE_FFT,  0,    0,    { 0, 0 } },
+    {   1024,   256, 2, 0,  1,     POD_ENGINE_FFT,  0,    64,   { 0, 0 } },
+    {   4096,   512, 1, 0,  1,     POD_ENGINE_FFT,  1,    0,    { 0, 0 } },
+    {   1024,   256, 1, 0,  0,     POD_ENGINE_FFT,  0,    0,    { 512, 256 } },
+    {   2048,   256, 2, 3,  0,     POD_ENGINE_FFT,  0,    128,  { 256, 0 } },
+    {   1024,    64, 1, 0,  0,     POD_ENGINE_SDFT, 0,    0,    { 0, 0 } },
+    {   2048,    32, 2, 0,  0,     POD_ENGINE_SDFT, 1,    0,    { 0, 0 } },
+    {   1024,    64, 1, 0,  0,     POD_ENGINE_BANK, 0,    0,    { 0, 0 } },
+    {   1024,    32, 3, 0,  0,     POD_ENGINE_BANK, 1,    16,   { 0, 0 } },
+    {   1024,   256, 1, 0,  0,     POD_ENGINE_BANK, 0,    0,    { 0, 0 } },
+};
+
+#define NUM_SETTINGS (int)(sizeof(settings) / sizeof(settings[0]))
+
+// Onsets and flux values in the order they came, as raw words so the comparison is bit for bit
+typedef struct _stress_log
+{
+    long long*  words;
+    int         count;
+    int         capacity;
+    
+} t_stress_log;
+
+typedef struct _stress_detector
+{
+    t_pod*          pod;
+    t_stress_log    log;
+    
+} t_stress_detector;
+
+typedef struct _stress_thread
+{
+    pthread_t           thread;
+    t_stress_detector*  detectors;
+    int                 first, last;
+    
+} t_stress_thread;
+
+static const float* inputs[STRESS_MAX_CHANNELS];
+static int input_length;
+static int block_size = 64;
+
+static void append(t_stress_log* log, long long a, long long b, long long c, float value)
+{
+    int bits;
+    
+    if (log->count + 4 > log->capacity)
+    {
+        log->capacity = log->capacity ? 2 * log->capacity : 1024;
+        log->words = (long long *)realloc(log->words, log->capacity * sizeof(long long));
+    }
+    
+    memcpy(&bits, &value, sizeof(bits));
+    log->words[log->count++] = a;
+    log->words[log->count++] = b;
+    log->words[log->count++] = c;
+    log->words[log->count++] = bits;
+}
+
+static void on_onset(void* user, const t_pod_onset* onset)
+{
+    append((t_stress_log *)user, onset->channel, onset->sample, onset->peak_sample, onset->peak);
+}
+
+static void on_flux(void* user, int channel, long long sample, float flux)
+{
+    append((t_stress_log *)user, -1 - channel, sample, 0, flux);
+}
+
+static int create(t_stress_detector* d, const t_stress_setting* setting)
+{
+    t_pod_config config;
+    
+    pod_config_init(&config);
+    config.window_size = setting->window_size;
+    config.hop_size = setting->hop_size;
+    config.channels = setting->channels;
+    config.latency = setting->latency;
+    config.spread = setting->spread;
+    config.engine = setting->engine;
+    config.power = setting->power;
+    config.phase = setting->phase;
+    config.percentile = 95.0f;
+    config.average_ms = 2000.0f;
+    memcpy(config.resolutions, setting->resolutions, sizeof(config.resolutions));
+    config.onset = on_onset;
+    config.flux = on_flux;
+    config.user = &d->log;
+    
+    d->log.count = 0;
+    d->pod = pod_create(&config);
+    if (d->pod == NULL)
+        return -1;
+        
+    pod_set_upper_threshold_scale(d->pod, 2.0f);
+    return 0;
+}
+
+static void process(t_stress_detector* d, int start)
+{
+    const float* in[STRESS_MAX_CHANNELS];
+    
+    for (int c = 0; c < STRESS_MAX_CHANNELS; c++)
+        in[c] = inputs[c] + start;
+    pod_process_channels(d->pod, in, block_size);
+}
+
+static void* thread_main(void* arg)
+{
+    t_stress_thread* t = (t_stress_thread *)arg;
+    
+    for (int start = 0; start + block_size <= input_length; start += block_size)
+        for (int i = t->first; i < t->last; i++)
+            process(&t->detectors[i], start);
+            
+    return NULL;
+}
+
+static int compare(const char* run, int i, const t_stress_log* alone, const t_stress_log* log)
+{
+    int length = alone->count < log->count ? alone->count : log->count;
+    int at = 0;
+    
+    while (at < length && alone->words[at] == log->words[at])
+        at++;
+        
+    if (at == length && alone->count == log->count)
+        return 0;
+        
+    printf("%s: detector %d first differs from its run alone at event %d (%d events alone, %d here)\n", run, i,
+           at / 4, alone->count / 4, log->count / 4);
+    return 1;
+}
+
+int main(int argc, char** argv)
+{
+    float seconds = 10.0f;
+    int threads = 4, failures = 0, option;
+    t_test_signal signals[STRESS_MAX_CHANNELS];
+    t_stress_detector alone[NUM_SETTINGS], together[NUM_SETTINGS];
+    static const char* kinds[STRESS_MAX_CHANNELS] = { "drums", "clicks", "tones" };
+    
+    while ((option = getopt(argc, argv, "d:b:t:")) != -1)
+    {
+        switch (option)
+        {
+            case 'd': seconds = atof(optarg); break;
+            case 'b': block_size = atoi(optarg); break;
+            case 't': threads = atoi(optarg); break;
+            default:
+                fprintf(stderr, "usage: stress [-d seconds] [-b block] [-t threads]\n");
+                return 2;
+        }
+    }
+    
+    if (block_size < 1 || threads < 0)
+        return 2;
+        
+    for (int c = 0; c < STRESS_MAX_CHANNELS; c++)
+    {
+        if (test_signal_make(&signals[c], kinds[c], seconds, 10.0f, 44100.0f, 7 + c) != 0)
+            return 1;
+        inputs[c] = signals[c].samples;
+    }
+    input_length = signals[0].length;
+    
+    memset(alone, 0, sizeof(alone));
+    memset(together, 0, sizeof(together));
+    
+    // Each one on its own, the only detector in the process
+    for (int i = 0; i < NUM_SETTINGS; i++)
+    {
+        if (create(&alone[i], &settings[i]) != 0)
+            return 1;
+        for (int start = 0; start + block_size <= input_length; start += block_size)
+            process(&alone[i], start);
+        pod_set_isa(pod_get_isa());
+        pod_destroy(alone[i].pod);
+        
+        if (alone[i].log.count == 0)
+        {
+            printf("detector %d reported nothing\n", i);
+            failures++;
+        }
+    }
+    
+    // All of them block by block, as one Pd patch
+    for (int i = 0; i < NUM_SETTINGS; i++)
+        if (create(&together[i], &settings[i]) != 0)
+            return 1;
+    for (int start = 0; start + block_size <= input_length; start += block_size)
+        for (int i = 0; i < NUM_SETTINGS; i++)
+            process(&together[i], start);
+    pod_set_isa(pod_get_isa());
+    for (int i = 0; i < NUM_SETTINGS; i++)
+    {
+        failures += compare("together", i, &alone[i].log, &together[i].log);
+        pod_destroy(together[i].pod);
+    }
+    
+    // Again, setting the kernel set in use between every block while the workers have frames out
+    for (int i = 0; i < NUM_SETTINGS; i++)
+        if (create(&together[i], &settings[i]) != 0)
+            return 1;
+    for (int start = 0; start + block_size <= input_length; start += block_size)
+    {
+        pod_set_isa(pod_get_isa());
+        for (int i = 0; i < NUM_SETTINGS; i++)
+            process(&together[i], start);
+    }
+    pod_set_isa(pod_get_isa());
+    for (int i = 0; i < NUM_SETTINGS; i++)
+    {
+        failures += compare("switching", i, &alone[i].log, &together[i].log);
+        pod_destroy(together[i].pod);
+    }
+    
+    // The same again with the detectors split between threads running at once
+    if (threads > 0)
+    {
+        t_stress_thread* t = (t_stress_thread *)calloc(threads, sizeof(t_stress_thread));
+        
+        for (int i = 0; i < NUM_SETTINGS; i++)
+            if (create(&together[i], &settings[i]) != 0)
+                return 1;
+                
+        for (int j = 0; j < threads; j++)
+        {
+            t[j].detectors = together;
+            t[j].first = NUM_SETTINGS * j / threads;
+            t[j].last = NUM_SETTINGS * (j + 1) / threads;
+            pthread_create(&t[j].thread, NULL, thread_main, &t[j]);
+        }
+        for (int j = 0; j < threads; j++)
+            pthread_join(t[j].thread, NULL);
+        pod_set_isa(pod_get_isa());
+        
+        for (int i = 0; i < NUM_SETTINGS; i++)
+        {
+            failures += compare("threads", i, &alone[i].log, &together[i].log);
+            pod_destroy(together[i].pod);
+        }
+        free(t);
+    }
+    
+    printf("%d detectors, %g s in blocks of %d, %d threads: %s\n", NUM_SETTINGS, seconds, block_size, threads,
+           failures ? "FAILED" : "every detector matches its run alone");
+           
+    for (int i = 0; i < NUM_SETTINGS; i++)
+    {
+        free(alone[i].log.words);
+        free(together[i].log.words);
+    }
+    for (int c = 0; c < STRESS_MAX_CHANNELS; c++)
+        test_signal_free(&signals[c]);
+    return failures ? 1 : 0;
+}